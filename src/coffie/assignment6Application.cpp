@@ -116,136 +116,286 @@
 	#TEST 7: Transporting zero (0) passengers
 			RESULT: Cannot transport 0 number of passengers
 
-*/
- 
-#include "graph.h"
+	#TEST 8: Graph that does not fit in the memory budget (-budget 64)
+			RESULT: Memory budget of 64 bytes exceeded... Not processing route
 
+	#TEST 9: City numbers that are sparse 64-bit ids, e.g. 0 -5 99999999999
+			RESULT: ids are mapped to vertex numbers on input and back on output
+					Route = 0  -5  99999999999
 
-int main() {
 
-   bool debug = false;
-   FILE *fp_in, *fp_out;
-   graph g;
-   bool directed = false;
+   Command line options
+   =================================================================================
 
-   //main variables
-   int scenario = 1; 
-   int num_vertices = 0;
-   int num_edges = 0;
-   int start_city = 0;
-   int destination_city = 0;
-   int total_number_tourists = 0;
-   int optimal_max_weight_array[MAXV];
-   int num_elements = 0;
-   int best_route_array[MAXV];
-   int best_route_counter = 0;
-
-   if ((fp_in = fopen("../data/input.txt","r")) == 0) {
-	  printf("Error can't open input input.txt\n");
-     getchar();
-     exit(0);
-   }
+   -budget <bytes>     fail any scenario whose graph and search structures would need more than
+                       this many bytes; a memory usage report is printed to the console at the end
 
-   if ((fp_out = fopen("../data/output.txt","w")) == 0) {
-	  printf("Error can't open output output.txt\n");
-     getchar();
-     exit(0);
-   }
+   -pages <kind>       back the search workspace of each thread, and every other block of 1 MB or
+                       more (in practice the packed adjacency, flow network and edge sort arrays
+                       of graphs with many roads), with huge pages: "transparent" maps it and
+                       advises the kernel to use transparent huge pages, "explicit" takes reserved
+                       huge pages (vm.nr_hugepages) and falls back to transparent ones when none
+                       are left. Edgenode lists are many small blocks and are never placed
 
+   -numa <policy>      place the same blocks across NUMA nodes: "interleave" spreads their pages
+                       over all nodes, a node number binds them to that node (needs libnuma)
 
-   fprintf(fp_out, "coffie\n");
+   -pipeline           read and parse scenarios on a background thread and write results on another,
+                       so that file I/O overlaps with solving; the output is identical
 
-   //read test cases from file
+   -external           build each maximum spanning tree out of core: edges are spilled to temporary
+                       files in sorted runs and merged into Kruskal's algorithm, so only the tree
+                       (O(V) memory) is ever held as edgenode lists
+
+   -kruskal            build each maximum spanning tree with Kruskal's algorithm over bucket-sorted
+                       edges when the capacities are small integers (no more than the number of
+                       roads); equal-capacity routes may be chosen differently than by Prim's
+
+   -compressed         store each graph as sorted, delta-encoded neighbour lists with bit-packed
+                       weights instead of edgenode lists; equal-capacity routes may be chosen in a
+                       different order
 
-   while(fscanf(fp_in, "%d %d", &num_vertices, &num_edges) != EOF){
+   -bottleneck-table <file>
+                       also write, for every scenario, the bottleneck between every pair of cities
+                       to a binary table file (see bottleneck.h) that load_bottleneck_table() maps
+                       into memory for O(1) lookups
 
-	   //break out of the loop or end program when we encounter 0 values for both cities and road segment
-		if(num_vertices == 0 && num_edges == 0) break;
+   -dispatch           run buses on several routes at once: the maximum flow from the start to the
+                       destination city, with each road carrying at most capacity-1 tourists per
+                       round over all routes, is split into routes, e.g.
+                          Minimum Number of Rounds = 2: using 2 routes
+                          Route 1 = 1  2  4  7
+                          Trips =  24  24
+                          Route 2 = 1  3  7
+                          Trips =  9  5
 
-		fprintf(fp_out, "Scenario %d\n", scenario);
+   -input <file>       read scenarios from this file instead of ../data/input.txt
 
-		//read the graph
-		read_graph_v2(fp_in, &g, directed, num_vertices, num_edges);
+   -output <file>      write results to this file instead of ../data/output.txt
+
+   -scenarios <a>[-<b>]
+                       solve only scenarios a to b (or a alone; "a-" runs to the end), keeping their
+                       numbers from the full input; the scenario offset index <input>.idx (see index.h)
+                       is used to seek straight to scenario a, and is built first if it is missing or
+                       out of date. Disjoint ranges can be run as separate processes.
+
+   -build-index        (re)build <input>.idx and stop
+
+   -shards <n>         split each graph into n regions handled by n worker processes; the workers
+                       summarize their regions as bottlenecks between boundary cities and the main
+                       process routes over those summaries (Linux only)
+
+*/
+ 
 
-		//read the start, destination and number of passengers
-		fscanf(fp_in, "%d %d %d",&start_city, &destination_city, &total_number_tourists);
+#include "pipeline.h"
+#include "index.h"
 
-		// check for same start vertex and destination vertex
-		if(start_city == destination_city){
-			fprintf(fp_out, "Start Vertex %d is the same as destination vertex %d . Cannot be allowed\n", start_city, destination_city);
-			fprintf(fp_out, "\n");
-			scenario += 1;
-			continue;
-		}
+#define IO_BUFFER_SIZE 65536
 
-		//check for zero number of passengers
-		if(total_number_tourists <= 0){
-			fprintf(fp_out, "Cannot transport %d number of passengers\n", total_number_tourists);
-			fprintf(fp_out, "\n");
-			scenario += 1;
-			continue;
-		}
 
-		//check for more than 20 numvertices
-		if(num_vertices > 20){
-			//read the graph
-			read_graph_v2(fp_in, &g, directed, num_vertices, num_edges);
-			//read the start, destination and number of passengers
-			fscanf(fp_in, "%d %d %d",&start_city, &destination_city, &total_number_tourists);
+int main(int argc, char *argv[]) {
 
-			fprintf(fp_out, "Number of vertices %d more than the limit of 20... Not processing route\n", num_vertices);
-			fprintf(fp_out, "\n");
+   FILE *fp_in, *fp_out;
+   scenario_options options;
+   bool pipelined = false;
 
-			scenario += 1;
+   //main variables
+   int scenario = 1; 
+   scenario_slot slot;
+   shard_pool pool;
+   int nshards = 0;
+   char *table_path = NULL;
+   const char *input_path = "../data/input.txt";
+   const char *output_path = "../data/output.txt";
+   char index_path[FILENAME_MAX];
+   scenario_index index;
+   bool indexed;                 /* a usable index was loaded */
+   bool build_index = false;
+   char range_end;               /* '-' in a range a-b or a- */
+   char *in_buffer = NULL;
+   char *out_buffer = NULL;
+   int arg;
+   int pages = PAGES_NORMAL;     /* placement of large blocks */
+   int numa_node = NUMA_DEFAULT;
+   char *number_end;             /* just after a parsed number */
+
+   init_scenario_options(&options);
+
+   for (arg = 1; arg < argc; arg++) {
+      if (strcmp(argv[arg], "-budget") == 0 && arg+1 < argc) {
+         set_memory_budget((size_t) strtoul(argv[++arg], NULL, 10));
+      }
+      else if (strcmp(argv[arg], "-pages") == 0 && arg+1 < argc) {
+         arg++;
+         if (strcmp(argv[arg], "transparent") == 0) pages = PAGES_TRANSPARENT;
+         else if (strcmp(argv[arg], "explicit") == 0) pages = PAGES_EXPLICIT;
+         else {
+            printf("Unknown page kind %s\n", argv[arg]);
+            exit(0);
+         }
+      }
+      else if (strcmp(argv[arg], "-numa") == 0 && arg+1 < argc) {
+         arg++;
+         if (strcmp(argv[arg], "interleave") == 0) numa_node = NUMA_INTERLEAVE;
+         else {
+            numa_node = (int) strtol(argv[arg], &number_end, 10);
+            if (number_end == argv[arg] || *number_end != '\0' || numa_node < 0) {
+               printf("Unknown NUMA policy %s\n", argv[arg]);
+               exit(0);
+            }
+         }
+      }
+      else if (strcmp(argv[arg], "-pipeline") == 0) {
+         pipelined = true;
+      }
+      else if (strcmp(argv[arg], "-external") == 0) {
+         options.external = true;
+      }
+      else if (strcmp(argv[arg], "-compressed") == 0) {
+         options.compressed = true;
+      }
+      else if (strcmp(argv[arg], "-kruskal") == 0) {
+         set_spanning_tree_kruskal(true);
+      }
+      else if (strcmp(argv[arg], "-dispatch") == 0) {
+         options.dispatch = true;
+      }
+      else if (strcmp(argv[arg], "-bottleneck-table") == 0 && arg+1 < argc) {
+         table_path = argv[++arg];
+      }
+      else if (strcmp(argv[arg], "-input") == 0 && arg+1 < argc) {
+         input_path = argv[++arg];
+      }
+      else if (strcmp(argv[arg], "-output") == 0 && arg+1 < argc) {
+         output_path = argv[++arg];
+      }
+      else if (strcmp(argv[arg], "-scenarios") == 0 && arg+1 < argc) {
+         arg++;
+         options.first_scenario = 0;
+         switch (sscanf(argv[arg], "%d%c%d", &options.first_scenario, &range_end, &options.last_scenario)) {
+            case 1:  options.last_scenario = options.first_scenario; break;
+            case 2:  options.last_scenario = (range_end == '-') ? 0 : -1; break;
+            case 3:  if (range_end != '-') options.last_scenario = -1; break;
+            default: options.first_scenario = 0;
+         }
+         if (options.first_scenario < 1 || options.last_scenario < 0 ||
+             (options.last_scenario != 0 && options.last_scenario < options.first_scenario)) {
+            printf("Invalid scenario range %s\n", argv[arg]);
+            exit(0);
+         }
+      }
+      else if (strcmp(argv[arg], "-build-index") == 0) {
+         build_index = true;
+      }
+      else if (strcmp(argv[arg], "-shards") == 0 && arg+1 < argc) {
+         nshards = atoi(argv[++arg]);
+      }
+      else {
+         printf("Unknown option %s\n", argv[arg]);
+         exit(0);
+      }
+   }
 
-			continue;
-		}
+   if (!set_memory_placement(pages, numa_node)) {
+      printf("Error can't place memory as asked on this system\n");
+      exit(0);
+   }
 
-		// if there is path found
-		if(find_path(&g, start_city, destination_city, optimal_max_weight_array, &num_elements, best_route_array, &best_route_counter)){
+   // workers are forked before any file is opened or thread started
+   if (nshards > 0) {
+      if (!start_shard_workers(&pool, nshards)) {
+         printf("Error can't start %d shard workers (limit %d)\n", nshards, MAX_SHARDS);
+         exit(0);
+      }
+      options.shards = &pool;
+   }
 
-			//get minimum weight in graph
-			int i;
-			int min_max_capacity = get_minimum_element(optimal_max_weight_array, num_elements);
+   if ((fp_in = fopen(input_path,"r")) == 0) {
+	  printf("Error can't open input %s\n", input_path);
+     getchar();
+     exit(0);
+   }
 
-			//get minimum number of trips
-			int min_num_trips = total_number_tourists / (min_max_capacity -1);
-			int min_num_trips_remainder = total_number_tourists % (min_max_capacity -1);
+   // stream buffers are charged to the io subsystem; stdio's default is used if they don't fit.
+   // setvbuf() must come before any other operation on the stream
+   if ((in_buffer = (char *) memory_allocate(MEM_IO, IO_BUFFER_SIZE)) != NULL)
+      setvbuf(fp_in, in_buffer, _IOFBF, IO_BUFFER_SIZE);
+
+   // seek straight to the first scenario wanted, through the offset index,
+   // rebuilding it if it is missing or does not match the input
+   snprintf(index_path, sizeof(index_path), "%s.idx", input_path);
+   if (build_index || options.first_scenario > 1) {
+      indexed = !build_index && load_scenario_index(index_path, fp_in, &index);
+      if (indexed && !seek_scenario(fp_in, &index, options.first_scenario)) {
+         free_scenario_index(&index);
+         indexed = false;
+      }
+      if (!indexed) {
+         if (!build_scenario_index(fp_in, &index) || !write_scenario_index(index_path, &index)) {
+            printf("Error can't build scenario index %s\n", index_path);
+            exit(0);
+         }
+         if (!build_index) seek_scenario(fp_in, &index, options.first_scenario);
+      }
+      if (build_index) {
+         printf("Indexed %d scenarios in %s\n", index.nscenarios, index_path);
+         free_scenario_index(&index);
+         fclose(fp_in);
+         exit(0);
+      }
+      free_scenario_index(&index);
+   }
 
-			if(min_num_trips_remainder > 0) min_num_trips += 1;
+   if ((fp_out = fopen(output_path,"w")) == 0) {
+	  printf("Error can't open output %s\n", output_path);
+     getchar();
+     exit(0);
+   }
+   if ((out_buffer = (char *) memory_allocate(MEM_IO, IO_BUFFER_SIZE)) != NULL)
+      setvbuf(fp_out, out_buffer, _IOFBF, IO_BUFFER_SIZE);
 
-			fprintf(fp_out, "Minimum Number of Trips = %d: ", min_num_trips);
 
-			for (i=0; i < min_num_trips-1; i++){
-				fprintf(fp_out, "  %d", min_max_capacity-1);
-			}
+   if (table_path != NULL && (options.fp_table = fopen(table_path, "wb")) == 0) {
+	  printf("Error can't open bottleneck table %s\n", table_path);
+     exit(0);
+   }
+   clear_memory_budget_exceeded();
 
-			if(min_num_trips_remainder > 0) fprintf(fp_out, "  %d", min_num_trips_remainder);
-			if(min_num_trips_remainder == 0) fprintf(fp_out, "  %d", min_max_capacity-1);
+   memory_track_static(MEM_SEARCH, search_workspace_bytes());
 
+   fprintf(fp_out, "coffie\n");
 
-			//print best route
-			fprintf(fp_out,"\n");
-			fprintf(fp_out,"Route = %d", start_city);
-			int j;
-			for(j=0; j < best_route_counter; j++){
-				fprintf(fp_out,"  %d", best_route_array[j]);
-			}
-			fprintf(fp_out,"\n");
-		} else{
-			fprintf(fp_out,"No Path Found for start vertex %d and destination vertex %d\n", start_city, destination_city);
-		}
+   //read test cases from file
 
-		//reset num_elements
-		num_elements = 0;
-		best_route_counter = 0;
-		scenario += 1; //increment scenario number
-		
-		//nextline formatter
-		fprintf(fp_out, "\n");
+   if (pipelined) {
+      scenario += run_pipeline(fp_in, fp_out, &options);
+   }
+   else {
+      init_scenario_slot(&slot, &options);
+
+      slot.scenario = options.first_scenario;
+      while ((options.last_scenario == 0 || slot.scenario <= options.last_scenario) &&
+             read_scenario(fp_in, &slot, &options)) {
+         solve_scenario(&slot, &options);
+         write_scenario(fp_out, &slot);
+         scenario += 1; //increment scenario count
+         slot.scenario += 1;
+      }
+
+      free_scenario_slot(&slot);
    }
 
+   if (options.shards != NULL) stop_shard_workers(&pool);
+
    fclose(fp_in);
    fclose(fp_out);
+   if (options.fp_table != NULL && fclose(options.fp_table) != 0)
+      printf("Error can't write bottleneck table %s\n", table_path);
+   memory_free(MEM_IO, in_buffer);
+   memory_free(MEM_IO, out_buffer);
+
+   printf("Processed %d scenarios\n", scenario - 1);
+   print_memory_report(stdout);
 
 }
@@ -0,0 +1,55 @@
+/* 
+  Interface file
+
+  All-pairs bottleneck table - the bottleneck capacity between every pair
+  of cities, from one maximum spanning forest and one traversal of it per
+  source city.
+
+  Tables are written to a binary file, one block per scenario, and can be
+  loaded back with the file memory-mapped, so each lookup is an array read.
+
+  Block format (native byte order):
+
+     int magic                      BOTTLENECK_MAGIC
+     int scenario
+     int nvertices                  n
+     int reserved                   0
+     vertex_id id[n]                city id of vertex 1 .. n
+     int capacity[n][n]             bottleneck from row to column city,
+                                    0 if unreachable or the same city
+     int pad[n*n % 2]               0, so each block is a multiple of 8
+                                    bytes and the next id[] stays aligned
+
+*/
+
+#ifndef BOTTLENECK_H
+#define BOTTLENECK_H
+
+#include "graph.h"
+
+#define BOTTLENECK_MAGIC 0x4B4E5442  /* "BTNK" */
+
+typedef struct {
+   int scenario;
+   int nvertices;
+   vertex_id *ids;               /* city id of each vertex, from index 0  */
+   int *capacity;                /* nvertices x nvertices, row major      */
+   void *mapping;                /* file mapping, or NULL if allocated    */
+   size_t mapping_size;
+} bottleneck_table;
+
+bool build_bottleneck_table(graph *g, bottleneck_table *t);
+
+bool write_bottleneck_table(FILE *fp_table, bottleneck_table *t);
+
+bool load_bottleneck_table(const char *path, int scenario, bottleneck_table *t);
+
+void free_bottleneck_table(bottleneck_table *t);
+
+/* bottleneck between vertices a and b, numbered from 1 */
+
+inline int lookup_bottleneck(bottleneck_table *t, int a, int b) {
+   return(t->capacity[(size_t) (a - 1) * t->nvertices + (b - 1)]);
+}
+
+#endif
@@ -0,0 +1,250 @@
+/* 
+
+  Implementation file
+
+  All-pairs bottleneck table - see bottleneck.h
+
+  The widest route between two cities follows the maximum spanning
+  forest, so the bottleneck from a source to every other city is the
+  smallest weight met on a walk of the forest from that source: O(V) per
+  source and O(V^2) for the table, after a single forest build.
+
+*/
+
+#include "bottleneck.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* bytes of the block of an n-city table, padding included */
+
+static size_t block_bytes(size_t n) {
+   return(4 * sizeof(int) + n * sizeof(vertex_id) + (n * n + n * n % 2) * sizeof(int));
+}
+
+/* heaviest edge between u and v, the one the tree would have used */
+
+static int tree_edge_weight(graph *g, int u, int v) {
+
+   edge_iterator e;
+   bool more;
+   int best = MAXINT;
+   bool found = false;
+
+   for (more = first_edge(g, u, &e); more; more = next_edge(g, &e)) {
+      if (e.y == v && (!found || e.weight > best)) {
+         best = e.weight;
+         found = true;
+      }
+   }
+   return(best);
+}
+
+/* fill one row of the table by walking the forest from source */
+
+static void fill_row(graph *forest, bottleneck_table *t, int source) {
+
+   int *row = &t->capacity[(size_t) (source - 1) * t->nvertices];
+   int stack[MAXV];              /* vertices still to expand */
+   bool seen[MAXV+1];
+   int top = 0;
+   int i, v;
+   edge_iterator e;
+   bool more;
+
+   for (i=1; i<=t->nvertices; i++) {
+      row[i-1] = 0;
+      seen[i] = false;
+   }
+
+   seen[source] = true;
+   stack[top++] = source;
+
+   while (top > 0) {
+      v = stack[--top];
+      for (more = first_edge(forest, v, &e); more; more = next_edge(forest, &e)) {
+         if (seen[e.y]) continue;
+         seen[e.y] = true;
+         row[e.y-1] = (v == source || e.weight < row[v-1]) ? e.weight : row[v-1];
+         stack[top++] = e.y;
+      }
+   }
+}
+
+/* Build the table for g; return false if there is not enough memory */
+
+bool build_bottleneck_table(graph *g, bottleneck_table *t) {
+
+   graph forest;                 /* maximum spanning forest of g */
+   bool covered[MAXV+1];         /* vertex already in the forest */
+   int parents[MAXV+1];          /* forest edges, one tree each   */
+   int n = g->nvertices;
+   int u, v;
+   bool ok = true;
+
+   if (n > MAXV) return(false);
+
+   t->nvertices = n;
+   t->mapping = NULL;
+   t->mapping_size = 0;
+   t->ids = (vertex_id *) memory_allocate(MEM_CACHE, (n + 1) * sizeof(vertex_id));
+   t->capacity = (int *) memory_allocate(MEM_CACHE, ((size_t) n * n + 1) * sizeof(int));
+   if (t->ids == NULL || t->capacity == NULL) {
+      free_bottleneck_table(t);
+      return(false);
+   }
+
+   for (v=1; v<=n; v++) {
+      t->ids[v-1] = get_vertex_id(g, v);
+      covered[v] = false;
+   }
+
+   /* one tree per component; keep the tree edges of new vertices */
+
+   initialize_graph(&forest, false);
+   forest.nvertices = n;
+
+   for (v=1; v<=n && ok; v++) {
+      if (covered[v]) continue;
+
+      spanning_tree(g, v);
+      get_search_parents(g, parents);
+      covered[v] = true;
+
+      for (u=1; u<=n && ok; u++) {
+         if (covered[u] || parents[u] == -1) continue;
+         covered[u] = true;
+         ok = insert_edge(&forest, u, parents[u], false, tree_edge_weight(g, u, parents[u]));
+      }
+   }
+
+   for (v=1; v<=n && ok; v++)
+      fill_row(&forest, t, v);
+
+   free_graph(&forest);
+   if (!ok) free_bottleneck_table(t);
+   return(ok);
+}
+
+bool write_bottleneck_table(FILE *fp_table, bottleneck_table *t) {
+
+   int header[4];
+   int pad = 0;
+   size_t n = t->nvertices;
+
+   header[0] = BOTTLENECK_MAGIC;
+   header[1] = t->scenario;
+   header[2] = t->nvertices;
+   header[3] = 0;
+
+   if (fwrite(header, sizeof(int), 4, fp_table) != 4) return(false);
+   if (fwrite(t->ids, sizeof(vertex_id), n, fp_table) != n) return(false);
+   if (fwrite(t->capacity, sizeof(int), n * n, fp_table) != n * n) return(false);
+   if (n * n % 2 == 1 && fwrite(&pad, sizeof(int), 1, fp_table) != 1) return(false);
+   return(true);
+}
+
+/* find the block for scenario in a table file image */
+
+static bool find_block(char *base, size_t size, int scenario, bottleneck_table *t) {
+
+   size_t at = 0;
+   size_t n;
+   int header[4];
+
+   while (at + sizeof(header) <= size) {
+      memcpy(header, base + at, sizeof(header));
+      if (header[0] != BOTTLENECK_MAGIC || header[2] < 0) return(false);
+
+      n = header[2];
+      if (at + block_bytes(n) > size) return(false);
+
+      if (header[1] == scenario) {
+         t->scenario = scenario;
+         t->nvertices = header[2];
+         t->ids = (vertex_id *) (base + at + sizeof(header));
+         t->capacity = (int *) (base + at + sizeof(header) + n * sizeof(vertex_id));
+         return(true);
+      }
+      at += block_bytes(n);
+   }
+   return(false);
+}
+
+/* Load the table of one scenario from a file written by             */
+/* write_bottleneck_table(); the file is memory-mapped where possible */
+
+bool load_bottleneck_table(const char *path, int scenario, bottleneck_table *t) {
+
+#ifndef _WIN32
+   int fd;
+   struct stat st;
+   void *base;
+
+   if ((fd = open(path, O_RDONLY)) < 0) return(false);
+   if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return(false);
+   }
+   base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (base == MAP_FAILED) return(false);
+
+   t->mapping = base;
+   t->mapping_size = st.st_size;
+   if (!find_block((char *) base, st.st_size, scenario, t)) {
+      munmap(base, st.st_size);
+      t->mapping = NULL;
+      return(false);
+   }
+   return(true);
+#else
+   FILE *fp;
+   long size;
+   char *base;
+
+   if ((fp = fopen(path, "rb")) == NULL) return(false);
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   rewind(fp);
+
+   base = (char *) memory_allocate(MEM_CACHE, size);
+   if (base == NULL || fread(base, 1, size, fp) != (size_t) size) {
+      memory_free(MEM_CACHE, base);
+      fclose(fp);
+      return(false);
+   }
+   fclose(fp);
+
+   t->mapping = base;
+   t->mapping_size = size;
+   if (!find_block(base, size, scenario, t)) {
+      memory_free(MEM_CACHE, base);
+      t->mapping = NULL;
+      return(false);
+   }
+   return(true);
+#endif
+}
+
+void free_bottleneck_table(bottleneck_table *t) {
+
+   if (t->mapping != NULL) {
+#ifndef _WIN32
+      munmap(t->mapping, t->mapping_size);
+#else
+      memory_free(MEM_CACHE, t->mapping);
+#endif
+   }
+   else {
+      memory_free(MEM_CACHE, t->ids);
+      memory_free(MEM_CACHE, t->capacity);
+   }
+   t->mapping = NULL;
+   t->ids = NULL;
+   t->capacity = NULL;
+}
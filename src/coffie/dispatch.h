@@ -0,0 +1,35 @@
+/* 
+  Interface file
+
+  Multi-route fleet dispatch - instead of sending every trip along the one
+  widest route, run buses on several routes at once.  Each road segment of
+  capacity w is taken to carry at most w-1 tourists per round, the same
+  seat count the single-route trip calculation uses.  A maximum flow from
+  the start to the destination city gives the most tourists that can move
+  per round; decomposing it into paths gives the routes and their loads.
+
+  The maximum flow is computed with FIFO push-relabel, using periodic
+  global relabeling (a breadth-first search from the destination) and the
+  gap heuristic.
+
+*/
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "graph.h"
+
+typedef struct {
+   int nroutes;                  /* routes carrying tourists             */
+   int *route_start;             /* route k is vertices[route_start[k]   */
+                                 /* .. route_start[k+1]-1]               */
+   int *vertices;                /* each route after the start city      */
+   int *load;                    /* tourists per round on each route     */
+   long long max_flow;           /* tourists per round, all routes       */
+} dispatch_plan;
+
+bool max_flow_dispatch(graph *g, int source, int sink, dispatch_plan *plan);
+
+void free_dispatch_plan(dispatch_plan *plan);
+
+#endif
@@ -0,0 +1,435 @@
+/* 
+
+  Implementation file
+
+  Multi-route fleet dispatch - see dispatch.h
+
+  The flow network is held in compressed sparse row form.  The roads
+  from v to y become one arc whose capacity is the sum of their w-1,
+  with a paired reverse arc of capacity 0; an undirected road appears
+  in both adjacency lists and so gives one such pair per direction.
+
+*/
+
+#include "dispatch.h"
+
+typedef struct {
+   int n;                        /* vertices, numbered 1 .. n            */
+   int m;                        /* arcs, including reverse arcs         */
+   int *first;                   /* arcs of v: first[v] .. first[v+1]-1  */
+   int *to;                      /* head of each arc                     */
+   int *reverse;                 /* paired arc                           */
+   int *capacity;                /* original capacity                    */
+   int *residual;                /* remaining capacity                   */
+   long long *excess;
+   int *height;
+   int *count;                   /* vertices at each height              */
+   int *current;                 /* next arc to try when discharging     */
+   int *queue;                   /* FIFO of active vertices              */
+   int *scan;                    /* breadth-first search order           */
+   bool *active;
+} flow_network;
+
+static void free_network(flow_network *f) {
+
+   memory_free(MEM_SEARCH, f->first);
+   memory_free(MEM_SEARCH, f->to);
+   memory_free(MEM_SEARCH, f->reverse);
+   memory_free(MEM_SEARCH, f->capacity);
+   memory_free(MEM_SEARCH, f->residual);
+   memory_free(MEM_SEARCH, f->excess);
+   memory_free(MEM_SEARCH, f->height);
+   memory_free(MEM_SEARCH, f->count);
+   memory_free(MEM_SEARCH, f->current);
+   memory_free(MEM_SEARCH, f->queue);
+   memory_free(MEM_SEARCH, f->scan);
+   memory_free(MEM_SEARCH, f->active);
+}
+
+static bool build_network(graph *g, flow_network *f) {
+
+   edge_iterator e;
+   bool more;
+   int n = g->nvertices;
+   int *fill;                    /* next free arc of each vertex          */
+   int *seen;                    /* last vertex with an arc to each y     */
+   int *slot;                    /* and that arc, so parallel roads merge */
+   int v, a, b;
+
+   f->n = n;
+   f->m = 0;
+   f->first = (int *) memory_allocate(MEM_SEARCH, (n + 2) * sizeof(int));
+   fill = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   seen = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   slot = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   if (f->first == NULL || fill == NULL || seen == NULL || slot == NULL) {
+      memory_free(MEM_SEARCH, fill);
+      memory_free(MEM_SEARCH, seen);
+      memory_free(MEM_SEARCH, slot);
+      return(false);
+   }
+
+   for (v=0; v<=n+1; v++) f->first[v] = 0;
+   for (v=0; v<=n; v++) seen[v] = 0;
+   for (v=1; v<=n; v++) {
+      for (more = first_edge(g, v, &e); more; more = next_edge(g, &e)) {
+         if (e.y < 1 || e.y > n || e.y == v || seen[e.y] == v) continue;
+         seen[e.y] = v;
+         f->first[v+1]++;        /* the arc itself    */
+         f->first[e.y+1]++;      /* its reverse arc   */
+         f->m += 2;
+      }
+   }
+   for (v=1; v<=n; v++) f->first[v+1] += f->first[v];
+   f->first[0] = 0;
+
+   f->to       = (int *) memory_allocate(MEM_SEARCH, (f->m + 1) * sizeof(int));
+   f->reverse  = (int *) memory_allocate(MEM_SEARCH, (f->m + 1) * sizeof(int));
+   f->capacity = (int *) memory_allocate(MEM_SEARCH, (f->m + 1) * sizeof(int));
+   f->residual = (int *) memory_allocate(MEM_SEARCH, (f->m + 1) * sizeof(int));
+   f->excess   = (long long *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(long long));
+   f->height   = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   f->count    = (int *) memory_allocate(MEM_SEARCH, (2 * n + 2) * sizeof(int));
+   f->current  = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   f->queue    = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   f->scan     = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   f->active   = (bool *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(bool));
+
+   if (f->to == NULL || f->reverse == NULL || f->capacity == NULL || f->residual == NULL ||
+       f->excess == NULL || f->height == NULL || f->count == NULL || f->current == NULL ||
+       f->queue == NULL || f->scan == NULL || f->active == NULL) {
+      memory_free(MEM_SEARCH, fill);
+      memory_free(MEM_SEARCH, seen);
+      memory_free(MEM_SEARCH, slot);
+      return(false);
+   }
+
+   for (v=0; v<=n; v++) {
+      fill[v] = f->first[v];
+      seen[v] = 0;
+   }
+
+   for (v=1; v<=n; v++) {
+      for (more = first_edge(g, v, &e); more; more = next_edge(g, &e)) {
+         if (e.y < 1 || e.y > n || e.y == v) continue;
+         if (seen[e.y] != v) {
+            seen[e.y] = v;
+            a = slot[e.y] = fill[v]++;
+            b = fill[e.y]++;
+            f->to[a] = e.y;
+            f->to[b] = v;
+            f->reverse[a] = b;
+            f->reverse[b] = a;
+            f->capacity[a] = 0;
+            f->capacity[b] = 0;
+         }
+         if (e.weight > 1)
+            f->capacity[slot[e.y]] += e.weight - 1;  /* one seat is the driver's */
+      }
+   }
+   for (a=0; a<f->m; a++) f->residual[a] = f->capacity[a];
+
+   memory_free(MEM_SEARCH, fill);
+   memory_free(MEM_SEARCH, seen);
+   memory_free(MEM_SEARCH, slot);
+   return(true);
+}
+
+/* Exact heights from breadth-first searches over residual arcs:    */
+/* distance to the sink, or n + distance to the source for vertices */
+/* that can only return their excess, or 2n for neither             */
+
+static void global_relabel(flow_network *f, int source, int sink) {
+
+   int n = f->n;
+   int head, tail, v, u, a, k, root, base;
+
+   for (v=1; v<=n; v++) f->height[v] = 2 * n;
+   for (k=0; k<=2*n+1; k++) f->count[k] = 0;
+
+   for (k=0; k<2; k++) {
+      root = (k == 0) ? sink : source;
+      base = (k == 0) ? 0 : n;
+      if (f->height[root] < 2 * n) continue;
+
+      f->height[root] = base;
+      head = tail = 0;
+      f->scan[tail++] = root;
+      while (head < tail) {
+         v = f->scan[head++];
+         for (a = f->first[v]; a < f->first[v+1]; a++) {
+            u = f->to[a];
+            if (f->residual[f->reverse[a]] > 0 && f->height[u] == 2 * n && u != source && u != sink) {
+               f->height[u] = f->height[v] + 1;
+               f->scan[tail++] = u;
+            }
+         }
+      }
+   }
+
+   f->height[source] = n;
+   for (v=1; v<=n; v++) {
+      f->count[f->height[v]]++;
+      f->current[v] = f->first[v];
+   }
+}
+
+/* Maximum flow from source to sink; arcs keep their residual capacity */
+
+static long long push_relabel(flow_network *f, int source, int sink) {
+
+   int n = f->n;
+   int head = 0, tail = 0, size = 0;  /* circular FIFO of active vertices */
+   int v, u, a, old_height, lowest;
+   long long delta;
+   long long work = 0;           /* arcs scanned since the last global relabel */
+
+   for (v=1; v<=n; v++) {
+      f->excess[v] = 0;
+      f->active[v] = false;
+   }
+
+   /* saturate every arc out of the source */
+
+   for (a = f->first[source]; a < f->first[source+1]; a++) {
+      if (f->residual[a] == 0) continue;
+      u = f->to[a];
+      f->excess[u] += f->residual[a];
+      f->excess[source] -= f->residual[a];
+      f->residual[f->reverse[a]] += f->residual[a];
+      f->residual[a] = 0;
+   }
+
+   global_relabel(f, source, sink);
+
+   for (v=1; v<=n; v++) {
+      if (v != source && v != sink && f->excess[v] > 0) {
+         f->active[v] = true;
+         f->queue[tail] = v;
+         tail = (tail + 1) % (n + 1);
+         size++;
+      }
+   }
+
+   while (size > 0) {
+      v = f->queue[head];
+      head = (head + 1) % (n + 1);
+      size--;
+      f->active[v] = false;
+
+      /* discharge v */
+
+      while (f->excess[v] > 0) {
+         if (f->current[v] == f->first[v+1]) {
+
+            /* relabel to one above the lowest admissible neighbour */
+
+            old_height = f->height[v];
+            lowest = 2 * n;
+            for (a = f->first[v]; a < f->first[v+1]; a++)
+               if (f->residual[a] > 0 && f->height[f->to[a]] + 1 < lowest)
+                  lowest = f->height[f->to[a]] + 1;
+            work += f->first[v+1] - f->first[v] + 12;
+
+            f->count[old_height]--;
+            f->height[v] = lowest;
+            f->count[lowest]++;
+            f->current[v] = f->first[v];
+
+            /* gap: nothing left at old_height, so nothing above it */
+            /* can reach the sink any more                          */
+
+            if (f->count[old_height] == 0 && old_height < n) {
+               for (u=1; u<=n; u++) {
+                  if (f->height[u] > old_height && f->height[u] < n && u != source) {
+                     f->count[f->height[u]]--;
+                     f->height[u] = n + 1;
+                     f->count[n+1]++;
+                     f->current[u] = f->first[u];
+                  }
+               }
+            }
+            if (f->height[v] >= 2 * n) break;  /* excess is stranded */
+            continue;
+         }
+
+         a = f->current[v];
+         u = f->to[a];
+         if (f->residual[a] > 0 && f->height[v] == f->height[u] + 1) {
+            delta = (f->excess[v] < f->residual[a]) ? f->excess[v] : f->residual[a];
+            f->residual[a] -= (int) delta;
+            f->residual[f->reverse[a]] += (int) delta;
+            f->excess[v] -= delta;
+            f->excess[u] += delta;
+            if (!f->active[u] && u != source && u != sink) {
+               f->active[u] = true;
+               f->queue[tail] = u;
+               tail = (tail + 1) % (n + 1);
+               size++;
+            }
+         }
+         else {
+            f->current[v]++;
+         }
+      }
+
+      if (work > 6 * n + f->m) {  /* heights have drifted; recompute them */
+         global_relabel(f, source, sink);
+         work = 0;
+      }
+   }
+
+   return(f->excess[sink]);
+}
+
+/* Make room for at least needed ints in *buffer, doubling its size */
+
+static bool reserve_ints(int **buffer, size_t *capacity, size_t used, size_t needed) {
+
+   int *larger;
+   size_t size = (*capacity > 0) ? *capacity : 64;
+
+   if (needed <= *capacity) return(true);
+   while (size < needed) size *= 2;
+
+   larger = (int *) memory_allocate(MEM_SEARCH, size * sizeof(int));
+   if (larger == NULL) return(false);
+   if (used > 0) memcpy(larger, *buffer, used * sizeof(int));
+   memory_free(MEM_SEARCH, *buffer);
+   *buffer = larger;
+   *capacity = size;
+   return(true);
+}
+
+/* Split the flow into source -> sink paths.  Each vertex keeps its  */
+/* place in its arc list across paths, since an arc whose flow has   */
+/* been used up never regains any; a walk that comes back on itself  */
+/* has found a flow cycle, which carries no one and is cancelled.    */
+
+static bool decompose_flow(flow_network *f, int source, int sink, dispatch_plan *plan) {
+
+   int n = f->n;
+   int *path_arc;                /* arc leaving the vertex at each depth */
+   int *position;                /* depth of each vertex on the walk, or -1 */
+   size_t vertices_capacity = 0; /* ints allocated in plan->vertices */
+   size_t used;
+   int depth, v, u, a, k, bottleneck;
+   bool ok = true;
+
+   path_arc = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   position = (int *) memory_allocate(MEM_SEARCH, (n + 1) * sizeof(int));
+   plan->route_start = (int *) memory_allocate(MEM_SEARCH, (f->m / 2 + 2) * sizeof(int));
+   plan->load = (int *) memory_allocate(MEM_SEARCH, (f->m / 2 + 1) * sizeof(int));
+   if (path_arc == NULL || position == NULL || plan->route_start == NULL || plan->load == NULL) {
+      ok = false;
+   }
+   else {
+      plan->route_start[0] = 0;
+      for (v=1; v<=n; v++) {
+         position[v] = -1;
+         f->current[v] = f->first[v];
+      }
+   }
+
+   plan->max_flow = 0;
+   while (ok) {
+      depth = 0;
+      v = source;
+      position[source] = 0;
+
+      while (v != sink) {
+         a = f->current[v];
+         while (a < f->first[v+1] && f->capacity[a] <= f->residual[a]) a++;
+         f->current[v] = a;
+         if (a == f->first[v+1]) break;  /* the source has nothing left */
+
+         path_arc[depth++] = a;
+         u = f->to[a];
+         if (position[u] < 0) {
+            position[u] = depth;
+            v = u;
+            continue;
+         }
+
+         /* cancel the cycle from u back to u */
+
+         bottleneck = f->capacity[a] - f->residual[a];
+         for (k = position[u]; k < depth; k++)
+            if (f->capacity[path_arc[k]] - f->residual[path_arc[k]] < bottleneck)
+               bottleneck = f->capacity[path_arc[k]] - f->residual[path_arc[k]];
+         for (k = position[u]; k < depth; k++) {
+            f->residual[path_arc[k]] += bottleneck;
+            if (k > position[u]) position[f->to[path_arc[k-1]]] = -1;
+         }
+         depth = position[u];
+         v = u;
+      }
+
+      for (k=0; k<depth; k++) position[f->to[path_arc[k]]] = -1;
+      position[source] = -1;
+      if (v != sink) break;
+
+      bottleneck = f->capacity[path_arc[0]] - f->residual[path_arc[0]];
+      for (k=1; k<depth; k++)
+         if (f->capacity[path_arc[k]] - f->residual[path_arc[k]] < bottleneck)
+            bottleneck = f->capacity[path_arc[k]] - f->residual[path_arc[k]];
+
+      used = plan->route_start[plan->nroutes];
+      if (!reserve_ints(&plan->vertices, &vertices_capacity, used, used + depth)) {
+         ok = false;
+         break;
+      }
+      for (k=0; k<depth; k++) {
+         f->residual[path_arc[k]] += bottleneck;
+         plan->vertices[used + k] = f->to[path_arc[k]];
+      }
+      plan->load[plan->nroutes] = bottleneck;
+      plan->max_flow += bottleneck;
+      plan->nroutes++;
+      plan->route_start[plan->nroutes] = (int) used + depth;
+   }
+
+   memory_free(MEM_SEARCH, path_arc);
+   memory_free(MEM_SEARCH, position);
+   return(ok);
+}
+
+/* Plan routes from source to sink in g. Return false if there is    */
+/* not enough memory; a plan with no routes means no flow at all.    */
+
+bool max_flow_dispatch(graph *g, int source, int sink, dispatch_plan *plan) {
+
+   flow_network f;
+   bool ok;
+
+   plan->nroutes = 0;
+   plan->route_start = NULL;
+   plan->vertices = NULL;
+   plan->load = NULL;
+   plan->max_flow = 0;
+
+   memset(&f, 0, sizeof(f));
+   if ((source < 1) || (source > g->nvertices) || (sink < 1) || (sink > g->nvertices) || source == sink)
+      return(true);
+
+   ok = build_network(g, &f);
+   if (ok) {
+      push_relabel(&f, source, sink);
+      ok = decompose_flow(&f, source, sink, plan);
+   }
+
+   free_network(&f);
+   if (!ok) free_dispatch_plan(plan);
+   return(ok);
+}
+
+void free_dispatch_plan(dispatch_plan *plan) {
+
+   memory_free(MEM_SEARCH, plan->route_start);
+   memory_free(MEM_SEARCH, plan->vertices);
+   memory_free(MEM_SEARCH, plan->load);
+   plan->route_start = NULL;
+   plan->vertices = NULL;
+   plan->load = NULL;
+   plan->nroutes = 0;
+}
@@ -0,0 +1,46 @@
+/* 
+  Interface file
+
+  External-memory maximum spanning tree - for graphs whose edges do not fit
+  in memory.  Edges are spilled to a temporary file in runs sorted by
+  descending weight.  The runs are merged EXTERNAL_MERGE_FANIN at a time, in
+  as many passes as needed, and the last merge feeds Kruskal's algorithm,
+  which needs a union-find over the vertices only.  At most two temporary
+  files are open at once, however many edges there are.
+  The accepted tree edges are written in a compact binary form and loaded
+  back as an ordinary graph, so prim() and find_path() work unchanged.
+  City ids are mapped to vertex numbers as in read_graph_v2().
+
+*/
+
+#ifndef EXTERNAL_H
+#define EXTERNAL_H
+
+#include "graph.h"
+
+#define EXTERNAL_RUN_EDGES   4096  /* edges sorted in memory per run      */
+#define EXTERNAL_MERGE_FANIN 64    /* runs merged at once                 */
+#define EXTERNAL_READ_EDGES  64    /* edges buffered per run while merging */
+
+/* outcome of read_graph_external() */
+
+#define EXTERNAL_OK            0
+#define EXTERNAL_NO_MEMORY     1   /* the memory budget ran out           */
+#define EXTERNAL_NO_TEMP_FILE  2   /* a temporary file could not be used  */
+
+/* one edge as stored in a run file */
+
+typedef struct {
+   int x;                        /* endpoints                        */
+   int y;
+   int weight;                   /* edge weight                      */
+   int sequence;                 /* input order, to break ties       */
+} edge_record;
+
+int read_graph_external(FILE *fp_in, graph *g, int num_vertices, int num_edges);
+
+bool write_spanning_tree(FILE *fp_tree, int num_vertices, edge_record *tree, int num_tree_edges);
+
+int load_spanning_tree(FILE *fp_tree, graph *g);
+
+#endif
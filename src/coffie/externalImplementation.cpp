@@ -0,0 +1,313 @@
+/* 
+
+  Implementation file
+
+  External-memory maximum spanning tree - see external.h
+
+  Memory use is one run buffer of EXTERNAL_RUN_EDGES edges, a read buffer
+  of EXTERNAL_READ_EDGES edges for each of at most EXTERNAL_MERGE_FANIN runs
+  being merged, the start and length of each run, and O(V) for the
+  union-find and the tree itself.  The graph is treated as undirected.
+
+  All runs of a pass live in one temporary file; a merge pass writes the
+  longer runs it makes to a second file, which then replaces the first.
+
+  Tree file format (binary, native byte order):
+
+     int num_vertices
+     int num_tree_edges
+     num_tree_edges x { int x, int y, int weight }
+
+*/
+
+#include "external.h"
+
+/* heavier edges first; equal weights in input order */
+
+static int compare_edge_records(const void *a, const void *b) {
+
+   const edge_record *p = (const edge_record *) a;
+   const edge_record *q = (const edge_record *) b;
+
+   if (p->weight != q->weight) return((p->weight > q->weight) ? -1 : 1);
+   return((p->sequence < q->sequence) ? -1 : (p->sequence > q->sequence));
+}
+
+/* a run: a sorted stretch of the run file */
+
+typedef struct {
+   long start;                   /* offset of its first record */
+   long length;                  /* records                    */
+} run_extent;
+
+/* a run being merged, read EXTERNAL_READ_EDGES records at a time */
+
+typedef struct {
+   long position;                /* offset of the next unbuffered record */
+   long remaining;               /* records not yet buffered             */
+   int count;                    /* records in the buffer                */
+   int next;                     /* next record to hand out              */
+   edge_record buffer[EXTERNAL_READ_EDGES];
+} run_reader;
+
+/* sort a run and append it to the run file */
+
+static bool spill_run(FILE *fp_runs, edge_record *run, int n, run_extent *extent) {
+
+   qsort(run, n, sizeof(edge_record), compare_edge_records);
+
+   if (fseek(fp_runs, 0, SEEK_END) != 0) return(false);
+   extent->start = ftell(fp_runs);
+   extent->length = n;
+   return(fwrite(run, sizeof(edge_record), n, fp_runs) == (size_t) n);
+}
+
+/* Next record of a run into *e: 1 if there is one, 0 at the end of */
+/* the run, -1 if the file cannot be read                           */
+
+static int read_run(FILE *fp_runs, run_reader *r, edge_record *e) {
+
+   long n;                       /* records to buffer */
+
+   if (r->next == r->count) {
+      if (r->remaining == 0) return(0);
+      n = (r->remaining < EXTERNAL_READ_EDGES) ? r->remaining : EXTERNAL_READ_EDGES;
+      if (fseek(fp_runs, r->position, SEEK_SET) != 0) return(-1);
+      if (fread(r->buffer, sizeof(edge_record), n, fp_runs) != (size_t) n) return(-1);
+      r->position += n * (long) sizeof(edge_record);
+      r->remaining -= n;
+      r->count = (int) n;
+      r->next = 0;
+   }
+   *e = r->buffer[r->next++];
+   return(1);
+}
+
+/* Merge heap of run heads: heap[] holds run numbers ordered by head[] */
+
+static void sift_down(int heap[], int n, edge_record head[], int i) {
+
+   int child;                    /* larger child */
+   int t;                        /* temporary    */
+
+   while ((child = 2*i + 1) < n) {
+      if (child+1 < n && compare_edge_records(&head[heap[child+1]], &head[heap[child]]) < 0)
+         child++;
+      if (compare_edge_records(&head[heap[child]], &head[heap[i]]) >= 0) break;
+      t = heap[i]; heap[i] = heap[child]; heap[child] = t;
+      i = child;
+   }
+}
+
+/* Merge k <= EXTERNAL_MERGE_FANIN runs of fp_runs. With fp_out, the  */
+/* merged run is appended there and described in *merged; without,   */
+/* the edges go to Kruskal's algorithm on g, which stops once the     */
+/* tree is complete. Return false if a temporary file failed.         */
+
+static bool merge_runs(FILE *fp_runs, run_extent *runs, int k, run_reader *readers,
+                       FILE *fp_out, run_extent *merged,
+                       graph *g, edge_record *tree, int *num_tree_edges) {
+
+   edge_record head[EXTERNAL_MERGE_FANIN];  /* current record of each run */
+   int heap[EXTERNAL_MERGE_FANIN];
+   int heap_size = 0;
+   int r, got;
+   edge_record e;
+
+   for (r=0; r<k; r++) {
+      readers[r].position = runs[r].start;
+      readers[r].remaining = runs[r].length;
+      readers[r].count = readers[r].next = 0;
+      if ((got = read_run(fp_runs, &readers[r], &head[r])) < 0) return(false);
+      if (got == 1) heap[heap_size++] = r;
+   }
+   for (r=heap_size/2 - 1; r>=0; r--)
+      sift_down(heap, heap_size, head, r);
+
+   /* runs[] may be where *merged lives, so only now overwrite it */
+
+   if (fp_out != NULL) {
+      if (fseek(fp_out, 0, SEEK_END) != 0) return(false);
+      merged->start = ftell(fp_out);
+      merged->length = 0;
+   }
+
+   while (heap_size > 0) {
+      r = heap[0];
+      e = head[r];
+
+      if (fp_out != NULL) {
+         if (fwrite(&e, sizeof(edge_record), 1, fp_out) != 1) return(false);
+         merged->length++;
+      }
+      else {
+         if (*num_tree_edges >= g->ids.nids - 1) break;
+         if (uf_union(g->component, g->component_size, e.x, e.y))
+            tree[(*num_tree_edges)++] = e;
+      }
+
+      if ((got = read_run(fp_runs, &readers[r], &head[r])) < 0) return(false);
+      if (got == 0) heap[0] = heap[--heap_size];
+      sift_down(heap, heap_size, head, 0);
+   }
+   return(true);
+}
+
+/* Read num_edges edges from fp_in and store only their maximum     */
+/* spanning forest in g.  Component labels are set as by            */
+/* read_graph_v2.  Return EXTERNAL_OK, or why the tree could not be */
+/* built (the input is still consumed so the file stays in step).   */
+
+int read_graph_external(FILE *fp_in, graph *g, int num_vertices, int num_edges) {
+
+   edge_record *run = NULL;      /* in-memory run buffer             */
+   run_extent *runs = NULL;      /* sorted runs in fp_runs           */
+   run_reader *readers = NULL;   /* one per run being merged         */
+   edge_record *tree = NULL;     /* accepted tree edges              */
+   FILE *fp_runs = NULL;         /* runs of the current pass         */
+   FILE *fp_merged = NULL;       /* runs made by a merge pass        */
+   FILE *fp_tree = NULL;         /* compact spanning tree            */
+   int max_runs;                 /* runs needed for num_edges        */
+   int num_runs = 0;
+   int n = 0;                    /* edges in the current run         */
+   int num_tree_edges = 0;
+   int i, r, k;
+   edge_record e;
+   vertex_id x_id, y_id;         /* external city ids                */
+   int status = EXTERNAL_OK;
+
+   initialize_graph(g, false);
+   g->nvertices = num_vertices;
+
+   max_runs = (num_edges + EXTERNAL_RUN_EDGES - 1) / EXTERNAL_RUN_EDGES;
+   if (max_runs == 0) max_runs = 1;
+
+   run     = (edge_record *) memory_allocate(MEM_GRAPH, EXTERNAL_RUN_EDGES * sizeof(edge_record));
+   runs    = (run_extent *) memory_allocate(MEM_IO, max_runs * sizeof(run_extent));
+   readers = (run_reader *) memory_allocate(MEM_IO, EXTERNAL_MERGE_FANIN * sizeof(run_reader));
+   tree    = (edge_record *) memory_allocate(MEM_GRAPH, MAXV * sizeof(edge_record));
+   if (run == NULL || runs == NULL || readers == NULL || tree == NULL) status = EXTERNAL_NO_MEMORY;
+   else if ((fp_runs = tmpfile()) == NULL) status = EXTERNAL_NO_TEMP_FILE;
+
+   /* pass 1: sorted runs, under provisional vertex numbers */
+
+   for (i=0; i<num_edges; i++) {
+      fscanf(fp_in, "%lld %lld %d", &x_id, &y_id, &e.weight);
+      e.x = map_vertex_id(g, x_id);
+      e.y = map_vertex_id(g, y_id);
+      e.sequence = i;
+      if (status != EXTERNAL_OK) continue;
+      if (e.x == 0 || e.y == 0) continue;  /* more than MAXV cities */
+
+      run[n++] = e;
+      if (n == EXTERNAL_RUN_EDGES) {
+         if (!spill_run(fp_runs, run, n, &runs[num_runs++])) status = EXTERNAL_NO_TEMP_FILE;
+         n = 0;
+      }
+   }
+   if (status == EXTERNAL_OK && n > 0) {
+      if (!spill_run(fp_runs, run, n, &runs[num_runs++])) status = EXTERNAL_NO_TEMP_FILE;
+   }
+
+   /* pass 2: merge EXTERNAL_MERGE_FANIN runs at a time into a new */
+   /* file until few enough remain for one final merge             */
+
+   while (status == EXTERNAL_OK && num_runs > EXTERNAL_MERGE_FANIN) {
+      if ((fp_merged = tmpfile()) == NULL) {
+         status = EXTERNAL_NO_TEMP_FILE;
+         break;
+      }
+      for (r=0, k=0; r<num_runs; r+=EXTERNAL_MERGE_FANIN, k++) {
+         i = (num_runs - r < EXTERNAL_MERGE_FANIN) ? num_runs - r : EXTERNAL_MERGE_FANIN;
+         if (!merge_runs(fp_runs, &runs[r], i, readers, fp_merged, &runs[k], NULL, NULL, NULL)) {
+            status = EXTERNAL_NO_TEMP_FILE;
+            break;
+         }
+      }
+      num_runs = k;
+      fclose(fp_runs);
+      fp_runs = fp_merged;
+      fp_merged = NULL;
+   }
+
+   /* pass 3: the final merge feeds Kruskal, stopping at V-1 tree edges */
+
+   if (status == EXTERNAL_OK && num_runs > 0) {
+      if (!merge_runs(fp_runs, runs, num_runs, readers, NULL, NULL, g, tree, &num_tree_edges))
+         status = EXTERNAL_NO_TEMP_FILE;
+   }
+
+   if (fp_runs != NULL) fclose(fp_runs);
+
+   /* pass 4: write the compact tree and load it as the graph */
+
+   if (status == EXTERNAL_OK) {
+      if ((fp_tree = tmpfile()) == NULL || !write_spanning_tree(fp_tree, g->ids.nids, tree, num_tree_edges))
+         status = EXTERNAL_NO_TEMP_FILE;
+   }
+   if (status == EXTERNAL_OK) {
+      rewind(fp_tree);
+      status = load_spanning_tree(fp_tree, g);
+   }
+   if (fp_tree != NULL) fclose(fp_tree);
+
+   memory_free(MEM_GRAPH, run);
+   memory_free(MEM_IO, runs);
+   memory_free(MEM_IO, readers);
+   memory_free(MEM_GRAPH, tree);
+
+   /* final vertex numbers, then flatten the component labels, */
+   /* as read_graph_v2 does                                    */
+
+   g->nvertices = num_vertices;
+   finish_vertex_map(g);
+
+   g->ncomponents = 0;
+   for (i=1; i<=g->nvertices; i++) {
+      g->component[i] = uf_find(g->component, i);
+      if (g->component[i] == i) g->ncomponents++;
+   }
+   return(status);
+}
+
+bool write_spanning_tree(FILE *fp_tree, int num_vertices, edge_record *tree, int num_tree_edges) {
+
+   int i;                        /* counter      */
+   int triple[3];                /* x, y, weight */
+
+   if (fwrite(&num_vertices, sizeof(int), 1, fp_tree) != 1) return(false);
+   if (fwrite(&num_tree_edges, sizeof(int), 1, fp_tree) != 1) return(false);
+
+   for (i=0; i<num_tree_edges; i++) {
+      triple[0] = tree[i].x;
+      triple[1] = tree[i].y;
+      triple[2] = tree[i].weight;
+      if (fwrite(triple, sizeof(int), 3, fp_tree) != 3) return(false);
+   }
+   return(true);
+}
+
+/* Insert the edges of a tree file into g, which must be initialized; */
+/* component labels are left to the caller. Return EXTERNAL_OK,       */
+/* EXTERNAL_NO_TEMP_FILE if the file cannot be read back, or          */
+/* EXTERNAL_NO_MEMORY if an edge cannot be stored.                    */
+
+int load_spanning_tree(FILE *fp_tree, graph *g) {
+
+   int i;                        /* counter      */
+   int num_vertices;
+   int num_tree_edges;
+   int triple[3];                /* x, y, weight */
+
+   if (fread(&num_vertices, sizeof(int), 1, fp_tree) != 1) return(EXTERNAL_NO_TEMP_FILE);
+   if (fread(&num_tree_edges, sizeof(int), 1, fp_tree) != 1) return(EXTERNAL_NO_TEMP_FILE);
+   if (num_vertices > MAXV) return(EXTERNAL_NO_TEMP_FILE);
+
+   g->nvertices = num_vertices;
+
+   for (i=0; i<num_tree_edges; i++) {
+      if (fread(triple, sizeof(int), 3, fp_tree) != 3) return(EXTERNAL_NO_TEMP_FILE);
+      if (!insert_edge(g, triple[0], triple[1], false, triple[2])) return(EXTERNAL_NO_MEMORY);
+   }
+   return(EXTERNAL_OK);
+}
@@ -9,16 +9,26 @@
   19 March 2017
 
 */
+
+#ifndef GRAPH_H
+#define GRAPH_H
  
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
 #include <ctype.h>
 
+#include "memory.h"
+#include "probes.h"
+
 #define TRUE 1
 #define FALSE 0
 
-#define QUEUESIZE       100
+#define MAX_N 100                /* largest grid map: rows          */
+#define MAX_M 100                /* and columns                     */
+#define MAX_SEARCH_V (MAX_N*MAX_M) /* largest vertex number searched  */
+
+#define QUEUESIZE       MAX_SEARCH_V
 
 typedef int item_type;
 
@@ -36,9 +46,8 @@ typedef struct {
 /* adjacency list. Vertices are numbered 1 .. MAXV                  */
 
 #define MAXV 20  /* maximum number of vertices */
-#define MAX_N 100
-#define MAX_M 100
 #define MAXINT 0
+#define COUNTING_SORT_MAX_WEIGHT 4096  /* kruskal(), if enabled, is used up to this weight */
 
 //Original code
 //typedef struct {
@@ -55,23 +64,158 @@ typedef struct edgenode {
    EDGENODE_PTR next;            /* next edge in list               */
 } edgenode;
 
+/* City numbers in the input may be arbitrary 64-bit ids. They are  */
+/* mapped to vertex numbers 1 .. MAXV with an open-addressing hash   */
+/* table when the graph is read. If every id is already a valid      */
+/* vertex number the mapping is the identity and costs nothing.      */
+
+#define VERTEX_MAP_BITS 6
+#define VERTEX_MAP_SIZE (1 << VERTEX_MAP_BITS) /* slots, at least 2*MAXV */
+
+typedef long long vertex_id;     /* city number as given in the input */
+
+typedef struct {
+        vertex_id key[VERTEX_MAP_SIZE];  /* external id in each slot      */
+        int index[VERTEX_MAP_SIZE];      /* its vertex number, 0 if empty */
+        vertex_id external[MAXV+1];      /* vertex number -> external id  */
+        int nids;                        /* distinct ids seen             */
+        bool identity;                   /* ids are the vertex numbers    */
+        bool overflow;                   /* more than MAXV distinct ids   */
+} vertex_map;
+
+/* A grid map is a graph with one vertex per cell and an edge to    */
+/* each of the four neighbouring cells. Nothing is stored: edges    */
+/* and weights are computed from the cell array when visited. The   */
+/* weight of an edge is the smaller capacity of its two cells and   */
+/* cells with capacity 0 or less are blocked.                       */
+
+typedef struct {
+        int (*cells)[MAX_M];     /* cell capacities, NULL if no map */
+        int dim_x;               /* rows                            */
+        int dim_y;               /* columns                         */
+} grid_map;
+
+/* A packed graph replaces the edgenode lists by one byte array.    */
+/* Each vertex's neighbours are sorted and stored as differences     */
+/* in group-varint form: a tag byte giving the length (1-4 bytes)    */
+/* of each of the next four values, then the values, little endian.  */
+/* The weights follow, each (weight - weight_base) in weight_bits    */
+/* bits. The array is padded so weights can be read 8 bytes at once. */
+
+#define PACKED_PADDING 8
+
+typedef struct {
+        unsigned char *bytes;    /* encoded adjacency, NULL if none */
+        size_t size;             /* bytes allocated                 */
+        size_t neighbours[MAXV+2]; /* start of each vertex's block  */
+        size_t weights[MAXV+1];  /* start of each vertex's weights  */
+        int weight_bits;         /* width of a packed weight        */
+        int weight_base;         /* smallest weight in the graph    */
+} packed_adjacency;
+
 typedef struct {
         edgenode *edges[MAXV+1]; /* adjacency info: list of edges   */
         int degree[MAXV+1];      /* number of edges for each vertex */
         int nvertices;           /* number of vertices in graph     */
         int nedges;              /* number of edges in graph        */
         bool directed;           /* is the graph directed?          */
+        int component[MAXV+1];   /* union-find parent of each vertex */
+        int component_size[MAXV+1]; /* size of component rooted here */
+        int ncomponents;         /* number of connected components  */
+        int max_weight;          /* no edge weighs more, 0 if none  */
+        vertex_map ids;          /* external city ids               */
+        grid_map grid;           /* implicit grid graph, if any     */
+        packed_adjacency packed; /* compressed edges, if any        */
 } graph;
 
+/* Visit the edges of vertex v in a stored or implicit grid graph:  */
+/*                                                                  */
+/*    for (more = first_edge(g, v, &e); more; more = next_edge(g, &e)) */
+/*       ... e.y, e.weight ...                                      */
+
+typedef struct {
+        edgenode *p;             /* next edgenode of a stored graph */
+        int v;                   /* vertex whose edges are visited  */
+        int direction;           /* next grid neighbour to try      */
+        int y;                   /* current edge: adjacent vertex   */
+        int weight;              /*               and its weight    */
+        const unsigned char *data; /* next byte of a packed graph   */
+        unsigned tag;            /* tag byte of the current group   */
+        int index;               /* edges of v visited so far       */
+} edge_iterator;
+
+bool next_grid_edge(graph *g, edge_iterator *e);
+
+/* decode the next neighbour and weight of a packed graph */
+
+inline bool next_packed_edge(graph *g, edge_iterator *e) {
+
+   packed_adjacency *a = &g->packed;
+   unsigned long long word;       /* 8 bytes holding the weight */
+   unsigned delta;
+   size_t bit;
+   int length, k;
+
+   if (e->index == g->degree[e->v]) return(false);
+
+   if ((e->index & 3) == 0) e->tag = *e->data++;
+   length = ((e->tag >> (2 * (e->index & 3))) & 3) + 1;
+
+   delta = 0;
+   for (k=0; k<length; k++) delta |= (unsigned) e->data[k] << (8 * k);
+   e->data += length;
+   e->y += delta;
+
+   bit = (size_t) e->index * a->weight_bits;
+   word = 0;
+   for (k=0; k<8; k++)
+      word |= (unsigned long long) a->bytes[a->weights[e->v] + bit / 8 + k] << (8 * k);
+   word >>= bit % 8;
+   e->weight = a->weight_base + (int) (word & ((1ULL << a->weight_bits) - 1));
+
+   e->index++;
+   return(true);
+}
+
+inline bool next_edge(graph *g, edge_iterator *e) {
+
+   if (g->grid.cells != NULL) return(next_grid_edge(g, e));
+
+   if (g->packed.bytes != NULL) return(next_packed_edge(g, e));
+
+   if (e->p == NULL) return(false);
+   e->y = e->p->y;
+   e->weight = e->p->weight;
+   e->p = e->p->next;
+   return(true);
+}
+
+inline bool first_edge(graph *g, int v, edge_iterator *e) {
+
+   e->v = v;
+   e->direction = 0;
+   e->p = (g->grid.cells != NULL) ? NULL : g->edges[v];
+   e->index = 0;
+   e->y = 0;
+   if (g->packed.bytes != NULL) e->data = g->packed.bytes + g->packed.neighbours[v];
+   return(next_edge(g, e));
+}
+
 
 void initialize_graph(graph *g, bool directed);
 
 bool read_graph(graph *g, bool directed);
  
-void insert_edge(graph *g, int x, int y, bool directed, int w);
+bool insert_edge(graph *g, int x, int y, bool directed, int w);
+
+void free_graph(graph *g);
+
+bool compress_graph(graph *g);
 
 void read_map(FILE *fp_in,   int map[][MAX_M], int map_dimension_x, int map_dimension_y);
 
+bool read_map_tile(FILE *fp_raster, int map[][MAX_M], int raster_dimension_y, int tile_x, int tile_y, int tile_dimension_x, int tile_dimension_y);
+
 void convert_map_values_to_characters(FILE *fp_out,   int map[][MAX_M], int map_dimension_x, int map_dimension_y);
 
 int get_graph_vertex_number(int map_column_size, int cell_index_x, int cell_index_y);
@@ -90,15 +234,39 @@ int convert_vertex_to_map_y_cordinates(int map_dimension_y, int vertex_number);
 
 void print_graph(graph *g);
 
+bool reserve_search_workspace(int nvertices);
+
 void initialize_search(graph *g);
 
-void bfs(graph *g, int start);
+void get_search_parents(graph *g, int parents[]);
 
-void process_vertex_late(int v);
+size_t search_workspace_bytes();
 
-void process_vertex_early(int v);
+void bfs(graph *g, int start);
 
-void process_edge(int x, int y);
+/* The exact behaviour of bfs depends on the functions             */
+/*    process vertex early()                                       */
+/*    process vertex late()                                        */
+/*    process edge()                                               */
+/* These functions allow us to customize what the traversal does   */
+/* as it makes its official visit to each edge and each vertex.    */
+/* They are inline so that the empty versions cost nothing in the  */
+/* bfs() inner loop; tracing is done with the probes in probes.h   */
+
+inline void process_vertex_late(int v) {
+   (void) v;
+   //printf("processed vertex %d\n",v);
+}
+
+inline void process_vertex_early(int v) {
+   (void) v;
+   //printf("processed vertex %d\n",v);
+}
+
+inline void process_edge(int x, int y) {
+   (void) x; (void) y;
+   //printf("processed edge (%d,%d)\n",x,y);
+}
 
 bool find_path(int start, int end, int parents[]);
 
@@ -130,6 +298,40 @@ bool read_graph_v2(FILE *fp_in, graph *g, bool directed, int num_vertices, int n
 
 void prim(graph *g, int start);
 
+void kruskal(graph *g, int start);
+
+void set_spanning_tree_kruskal(bool enabled);
+
+void spanning_tree(graph *g, int start);
+
 int get_weight_between_parent_and_vertex(graph *g, int parent, int vertex);
 
-int get_minimum_element(int *my_array, int num_elements);
\ No newline at end of file
+int get_minimum_element(int *my_array, int num_elements);
+
+/* Union-find (disjoint set) used to label connected components     */
+
+void uf_init(int uf_parent[], int uf_size[], int n);
+
+int uf_find(int uf_parent[], int x);
+
+bool uf_union(int uf_parent[], int uf_size[], int x, int y);
+
+int find_component(graph *g, int v);
+
+bool same_component(graph *g, int x, int y);
+
+int get_component_size(graph *g, int v);
+
+/* External city id <-> vertex number mapping                       */
+
+void initialize_vertex_map(vertex_map *m);
+
+int map_vertex_id(graph *g, vertex_id id);
+
+void finish_vertex_map(graph *g);
+
+int find_vertex(graph *g, vertex_id id);
+
+vertex_id get_vertex_id(graph *g, int v);
+
+#endif
@@ -13,11 +13,35 @@
  
 #include "graph.h"
 
-/* Breadth-First Search data structures */
-
-bool processed[MAXV+1];   /* which vertices have been processed */
-bool discovered[MAXV+1];  /* which vertices have been found */
-int  parent[MAXV+1];      /* discovery relation */
+/* Breadth-First Search data structures                             */
+/* one copy per thread so that concurrent readers of a versioned    */
+/* graph can run prim() and find_path() at the same time            */
+/*                                                                  */
+/* The arrays point at the fixed ones below for graphs of up to     */
+/* MAXV vertices; a grid graph, or any graph once a memory          */
+/* placement is set, gets a tracked block that follows the          */
+/* placement, grown as needed and kept until the thread exits       */
+/* (reserve_search_workspace)                                       */
+
+thread_local bool *processed;    /* which vertices have been processed */
+thread_local bool *discovered;   /* which vertices have been found */
+thread_local int  *parent;       /* discovery relation */
+thread_local bool *intree;       /* prim(): is the vertex in the tree yet? */
+thread_local int  *distance;     /* prim(): cost of adding to tree */
+
+static thread_local bool small_processed[MAXV+1];
+static thread_local bool small_discovered[MAXV+1];
+static thread_local int  small_parent[MAXV+1];
+static thread_local bool small_intree[MAXV+1];
+static thread_local int  small_distance[MAXV+1];
+
+typedef struct search_workspace {
+   void *block;                  /* MEM_SEARCH block, NULL if none */
+   int nvertices;                /* vertices it holds              */
+   ~search_workspace() { memory_free(MEM_SEARCH, block); }
+} search_workspace;
+
+static thread_local search_workspace search_block = {NULL, 0};
 
 bool debug = true;
 
@@ -36,6 +60,18 @@ void initialize_graph(graph *g, bool directed){
 
    for (i=1; i<=MAXV; i++) 
       g->edges[i] = NULL; 
+
+   uf_init(g->component, g->component_size, MAXV);
+   g->ncomponents = 0;
+   g->max_weight = 0;
+   initialize_vertex_map(&g->ids);
+
+   g->grid.cells = NULL;
+   g->grid.dim_x = 0;
+   g->grid.dim_y = 0;
+
+   g->packed.bytes = NULL;
+   g->packed.size = 0;
 }
 
 /* Initialize graph from data in a file                             */
@@ -74,27 +110,195 @@ bool read_graph(graph *g, bool directed) {
 
 
 
-/* insert edge in a graphs */
+/* insert edge in a graphs                                         */
+/* return false if the edgenode could not be allocated              */
 
-void insert_edge(graph *g, int x, int y, bool directed, int w) {
+bool insert_edge(graph *g, int x, int y, bool directed, int w) {
 
    edgenode *p;                  /* temporary pointer */
       
-   p = (EDGENODE_PTR) malloc(sizeof(edgenode)); /* allocate edgenode storage */
+   p = (EDGENODE_PTR) memory_allocate(MEM_GRAPH, sizeof(edgenode)); /* allocate edgenode storage */
      //^^^^^^^^^^^^^^ ADDED CAST. DV 7/11/2014
 
+   if (p == NULL) return(false); /* memory budget exhausted */
+
    p->weight = w;
    p->y = y;
    p->next = g->edges[x];
 
+   if (w > g->max_weight) g->max_weight = w;
+
    g->edges[x] = p;              /* insert at head of list        */
 
    g->degree[x] ++;
 
    if (directed == false)        /* NB: if undirected add         */
-      insert_edge(g,y,x,true,w); /* the reverse edge recursively  */  
+      return(insert_edge(g,y,x,true,w)); /* the reverse edge recursively */
    else                          /* but directed TRUE so we do it */
       g->nedges ++;              /* only once                     */
+
+   return(true);
+}
+
+/* Release the edgenode lists; the graph is left empty              */
+
+void free_graph(graph *g) {
+
+   int i;                        /* counter           */
+   edgenode *p, *next;           /* temporary pointers */
+
+   for (i=1; i<=MAXV; i++) {
+      p = g->edges[i];
+      while (p != NULL) {
+         next = p->next;
+         memory_free(MEM_GRAPH, p);
+         p = next;
+      }
+      g->edges[i] = NULL;
+      g->degree[i] = 0;
+   }
+   g->nedges = 0;
+   g->max_weight = 0;
+
+   memory_free(MEM_GRAPH, g->packed.bytes);
+   g->packed.bytes = NULL;
+   g->packed.size = 0;
+}
+
+/* Compressed adjacency (see packed_adjacency in graph.h)           */
+
+typedef struct {
+   int y;                        /* neighbour          */
+   int weight;                   /* edge weight        */
+} packed_edge;
+
+static int compare_packed_edges(const void *a, const void *b) {
+
+   const packed_edge *p = (const packed_edge *) a;
+   const packed_edge *q = (const packed_edge *) b;
+
+   if (p->y != q->y) return((p->y < q->y) ? -1 : 1);
+   return((p->weight < q->weight) ? -1 : (p->weight > q->weight));
+}
+
+static int varint_length(unsigned x) {
+   return((x < (1u << 8)) ? 1 : (x < (1u << 16)) ? 2 : (x < (1u << 24)) ? 3 : 4);
+}
+
+/* copy v's edges into list, sorted by neighbour; return the count */
+
+static int sorted_edges(graph *g, int v, packed_edge *list) {
+
+   edgenode *p;
+   int n = 0;
+
+   for (p = g->edges[v]; p != NULL; p = p->next) {
+      list[n].y = p->y;
+      list[n].weight = p->weight;
+      n++;
+   }
+   qsort(list, n, sizeof(packed_edge), compare_packed_edges);
+   return(n);
+}
+
+/* Replace the edgenode lists of g by a packed byte array.          */
+/* The graph is read-only afterwards. Return false, leaving g as it */
+/* was, if there is not enough memory.                              */
+
+bool compress_graph(graph *g) {
+
+   packed_adjacency *a = &g->packed;
+   packed_edge *list;            /* one vertex's edges, sorted */
+   edgenode *p, *next;
+   long long lo, hi;             /* weight range               */
+   size_t size = 0;              /* bytes needed               */
+   size_t at;                    /* write position             */
+   size_t bit;
+   unsigned delta;
+   unsigned long long value;
+   int max_degree = 0;
+   int v, i, k, n, length, previous;
+   unsigned char *tag = NULL;
+   bool first = true;
+
+   if (g->grid.cells != NULL || a->bytes != NULL) return(false);
+
+   lo = hi = 0;
+   for (v=1; v<=MAXV; v++) {
+      if (g->degree[v] > max_degree) max_degree = g->degree[v];
+      for (p = g->edges[v]; p != NULL; p = p->next) {
+         if (first || p->weight < lo) lo = p->weight;
+         if (first || p->weight > hi) hi = p->weight;
+         first = false;
+      }
+   }
+   a->weight_base = (int) lo;
+   for (a->weight_bits = 0; (hi - lo) >> a->weight_bits; a->weight_bits++)
+      ;
+
+   list = (packed_edge *) memory_allocate(MEM_SEARCH, (max_degree + 1) * sizeof(packed_edge));
+   if (list == NULL) return(false);
+
+   /* pass 1: sizes */
+
+   for (v=1; v<=MAXV; v++) {
+      n = sorted_edges(g, v, list);
+      previous = 0;
+      size += (n + 3) / 4;       /* tag bytes */
+      for (i=0; i<n; i++) {
+         size += varint_length((unsigned) (list[i].y - previous));
+         previous = list[i].y;
+      }
+      size += ((size_t) n * a->weight_bits + 7) / 8;
+   }
+
+   a->bytes = (unsigned char *) memory_allocate(MEM_GRAPH, size + PACKED_PADDING);
+   if (a->bytes == NULL) {
+      memory_free(MEM_SEARCH, list);
+      return(false);
+   }
+   memset(a->bytes, 0, size + PACKED_PADDING);
+   a->size = size + PACKED_PADDING;
+
+   /* pass 2: encode */
+
+   at = 0;
+   for (v=1; v<=MAXV; v++) {
+      n = sorted_edges(g, v, list);
+      a->neighbours[v] = at;
+      previous = 0;
+      for (i=0; i<n; i++) {
+         if ((i & 3) == 0) tag = &a->bytes[at++];
+         delta = (unsigned) (list[i].y - previous);
+         length = varint_length(delta);
+         *tag |= (unsigned char) ((length - 1) << (2 * (i & 3)));
+         for (k=0; k<length; k++) a->bytes[at++] = (unsigned char) (delta >> (8 * k));
+         previous = list[i].y;
+      }
+
+      a->weights[v] = at;
+      for (i=0; i<n; i++) {
+         value = (unsigned long long) ((long long) list[i].weight - lo);
+         bit = (size_t) i * a->weight_bits;
+         for (k=0; k<a->weight_bits; k++)
+            if ((value >> k) & 1) a->bytes[at + (bit + k) / 8] |= (unsigned char) (1 << ((bit + k) % 8));
+      }
+      at += ((size_t) n * a->weight_bits + 7) / 8;
+   }
+   a->neighbours[MAXV+1] = at;
+
+   memory_free(MEM_SEARCH, list);
+
+   /* the lists are no longer needed; degrees and counts stay */
+
+   for (v=1; v<=MAXV; v++) {
+      for (p = g->edges[v]; p != NULL; p = next) {
+         next = p->next;
+         memory_free(MEM_GRAPH, p);
+      }
+      g->edges[v] = NULL;
+   }
+   return(true);
 }
 
 /* Print a graph                                                    */
@@ -102,18 +306,16 @@ void insert_edge(graph *g, int x, int y, bool directed, int w) {
 void print_graph(graph *g) {
         
    int i;                             /* counter           */
-   edgenode *p;                       /* temporary pointer */
+   edge_iterator e;                   /* edges of vertex i */
+   bool more;                         /* e holds an edge   */
 
    printf("Graph adjacency list:\n");
 
    for (i=1; i<=g->nvertices; i++) {
       printf("%d: ",i);
-      p = g->edges[i];
-      while (p != NULL) {
-
-         printf(" %d-%d", p->y, p->weight);
+      for (more = first_edge(g, i, &e); more; more = next_edge(g, &e)) {
 
-         p = p->next;
+         printf(" %d-%d", e.y, e.weight);
       }
       printf("\n");
    }
@@ -130,15 +332,267 @@ bool read_graph_v2(FILE *fp_in, graph *g, bool directed, int num_vertices, int n
    g->nvertices = num_vertices;
 	//g->nedges = num_edges - 1;
    int i;
+   vertex_id start_id = 0;
+   vertex_id dest_id = 0;
    int start_city = 0;
    int dest_city = 0;
    int weight_capacity = 0;
+   bool loaded = true;
+
+   /* keep reading after an allocation failure so the file stays in step; */
+   /* edges are stored under provisional vertex numbers until the end     */
 
    for (i=0; i<num_edges; i++) {
-	   fscanf(fp_in, "%d %d %d", &start_city, &dest_city, &weight_capacity);
-	   insert_edge(g, start_city, dest_city, directed, weight_capacity);
+	   fscanf(fp_in, "%lld %lld %d", &start_id, &dest_id, &weight_capacity);
+	   start_city = map_vertex_id(g, start_id);
+	   dest_city = map_vertex_id(g, dest_id);
+	   if (start_city == 0 || dest_city == 0) continue;  /* too many cities */
+	   if (loaded && !insert_edge(g, start_city, dest_city, directed, weight_capacity))
+	      loaded = false;
+	   uf_union(g->component, g->component_size, start_city, dest_city);
+   }
+
+   finish_vertex_map(g);
+
+   /* flatten the union-find forest so that every vertex points     */
+   /* directly at its root; connectivity queries are then O(1)      */
+
+   g->ncomponents = 0;
+   for (i=1; i<=g->nvertices; i++) {
+      g->component[i] = uf_find(g->component, i);
+      if (g->component[i] == i) g->ncomponents++;
+   }
+   return (loaded);
+}
+
+
+/* Union-find with union by size and path compression.             */
+/* Elements are numbered 1 .. n to match the vertex numbering       */
+
+void uf_init(int uf_parent[], int uf_size[], int n) {
+
+   int i;                          /* counter */
+
+   for (i=1; i<=n; i++) {
+      uf_parent[i] = i;
+      uf_size[i] = 1;
+   }
+}
+
+int uf_find(int uf_parent[], int x) {
+
+   int root;                       /* representative of x's set */
+   int next;                       /* temporary                 */
+
+   root = x;
+   while (uf_parent[root] != root)
+      root = uf_parent[root];
+
+   while (uf_parent[x] != root) {  /* path compression */
+      next = uf_parent[x];
+      uf_parent[x] = root;
+      x = next;
+   }
+   return(root);
+}
+
+/* merge the sets containing x and y; return false if already merged */
+
+bool uf_union(int uf_parent[], int uf_size[], int x, int y) {
+
+   int root_x = uf_find(uf_parent, x);
+   int root_y = uf_find(uf_parent, y);
+
+   if (root_x == root_y) return(false);
+
+   if (uf_size[root_x] < uf_size[root_y]) { /* attach smaller tree */
+      uf_parent[root_x] = root_y;
+      uf_size[root_y] += uf_size[root_x];
+   }
+   else {
+      uf_parent[root_y] = root_x;
+      uf_size[root_x] += uf_size[root_y];
+   }
+   return(true);
+}
+
+/* Connected-component queries on a graph loaded by read_graph_v2   */
+
+int find_component(graph *g, int v) {
+   return(uf_find(g->component, v));
+}
+
+/* true if x and y are valid vertices in the same component;         */
+/* grid maps are not labelled, so any two cells may be connected      */
+
+bool same_component(graph *g, int x, int y) {
+
+   if ((x < 1) || (x > g->nvertices) || (y < 1) || (y > g->nvertices))
+      return(false);
+
+   if (g->grid.cells != NULL) return(true);
+
+   return(find_component(g, x) == find_component(g, y));
+}
+
+/* number of vertices in the component containing v; 0 if unknown    */
+
+int get_component_size(graph *g, int v) {
+
+   if ((v < 1) || (v > g->nvertices) || (g->grid.cells != NULL)) return(0);
+
+   return(g->component_size[find_component(g, v)]);
+}
+
+
+/* External city ids                                                 */
+/*                                                                   */
+/* While a graph is read, each new id gets the next provisional      */
+/* vertex number. finish_vertex_map() then renumbers the vertices:   */
+/* to the ids themselves if they all lie in 1 .. nvertices, and      */
+/* otherwise to the rank of each id, so vertex order follows id order */
+/* either way and prim() breaks ties exactly as it would on the ids.  */
+
+void initialize_vertex_map(vertex_map *m) {
+
+   int i;                          /* counter */
+
+   for (i=0; i<VERTEX_MAP_SIZE; i++)
+      m->index[i] = 0;
+   m->nids = 0;
+   m->identity = true;             /* until an id is mapped */
+   m->overflow = false;
+}
+
+/* Fibonacci hashing: multiply by 2^64 / golden ratio, keep the top bits */
+
+static int vertex_map_slot(vertex_id id) {
+   return((int) (((unsigned long long) id * 0x9E3779B97F4A7C15ULL) >> (64 - VERTEX_MAP_BITS)));
+}
+
+/* vertex number of id, assigning the next one if it is new;         */
+/* 0 once more than MAXV distinct ids have been seen                 */
+
+int map_vertex_id(graph *g, vertex_id id) {
+
+   vertex_map *m = &g->ids;
+   int slot;
+
+   m->identity = false;
+
+   for (slot = vertex_map_slot(id); m->index[slot] != 0; slot = (slot + 1) & (VERTEX_MAP_SIZE - 1))
+      if (m->key[slot] == id) return(m->index[slot]);
+
+   if (m->nids == MAXV) {
+      m->overflow = true;
+      return(0);
+   }
+
+   m->nids++;
+   m->key[slot] = id;
+   m->index[slot] = m->nids;
+   m->external[m->nids] = id;
+   return(m->nids);
+}
+
+static int compare_vertex_ids(const void *a, const void *b) {
+
+   vertex_id p = *(const vertex_id *) a;
+   vertex_id q = *(const vertex_id *) b;
+
+   return((p < q) ? -1 : (p > q));
+}
+
+/* renumber the provisional vertices; call after the last map_vertex_id() */
+
+void finish_vertex_map(graph *g) {
+
+   vertex_map *m = &g->ids;
+   int perm[MAXV+1];               /* provisional -> final number */
+   vertex_id sorted[MAXV];         /* ids in ascending order      */
+   edgenode *edges[MAXV+1];
+   int degree[MAXV+1];
+   int component[MAXV+1];
+   int component_size[MAXV+1];
+   vertex_id external[MAXV+1];
+   edgenode *p;
+   int i, lo, hi, mid;
+   bool identity = true;
+
+   for (i=1; i<=m->nids; i++)
+      if (m->external[i] < 1 || m->external[i] > g->nvertices) identity = false;
+
+   if (identity) {
+      for (i=1; i<=m->nids; i++) perm[i] = (int) m->external[i];
+   }
+   else {
+      for (i=1; i<=m->nids; i++) sorted[i-1] = m->external[i];
+      qsort(sorted, m->nids, sizeof(vertex_id), compare_vertex_ids);
+
+      for (i=1; i<=m->nids; i++) {  /* rank by binary search */
+         lo = 0;
+         hi = m->nids - 1;
+         while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (sorted[mid] < m->external[i]) lo = mid + 1;
+            else hi = mid;
+         }
+         perm[i] = lo + 1;
+      }
+      if (g->nvertices < m->nids) g->nvertices = m->nids;
+   }
+
+   for (i=1; i<=MAXV; i++) {
+      edges[i] = NULL;
+      degree[i] = 0;
+      component[i] = i;
+      component_size[i] = 1;
+      external[i] = i;
+   }
+
+   for (i=1; i<=m->nids; i++) {
+      edges[perm[i]] = g->edges[i];
+      degree[perm[i]] = g->degree[i];
+      component[perm[i]] = perm[g->component[i]];
+      component_size[perm[i]] = g->component_size[i];
+      external[perm[i]] = m->external[i];
+      for (p = g->edges[i]; p != NULL; p = p->next)
+         p->y = perm[p->y];
    }
-   return (true);
+
+   for (i=1; i<=MAXV; i++) {
+      g->edges[i] = edges[i];
+      g->degree[i] = degree[i];
+      g->component[i] = component[i];
+      g->component_size[i] = component_size[i];
+      m->external[i] = external[i];
+   }
+
+   for (i=0; i<VERTEX_MAP_SIZE; i++)
+      if (m->index[i] != 0) m->index[i] = perm[m->index[i]];
+
+   m->identity = identity;
+}
+
+/* vertex number of an external id, 0 if the id is not in the graph */
+
+int find_vertex(graph *g, vertex_id id) {
+
+   vertex_map *m = &g->ids;
+   int slot;
+
+   if (m->identity)
+      return((id >= 1 && id <= g->nvertices) ? (int) id : 0);
+
+   for (slot = vertex_map_slot(id); m->index[slot] != 0; slot = (slot + 1) & (VERTEX_MAP_SIZE - 1))
+      if (m->key[slot] == id) return(m->index[slot]);
+   return(0);
+}
+
+vertex_id get_vertex_id(graph *g, int v) {
+
+   if (g->ids.identity) return(v);
+   return(g->ids.external[v]);
 }
 
 
@@ -150,18 +604,176 @@ void reset_start_and_destination_coordinates(int *start_x, int *start_y, int *go
 	*goal_y = 0;
 }
 
+/* Point the search arrays at storage for nvertices vertices; return */
+/* false if a grid graph's workspace cannot be allocated. Small      */
+/* graphs fall back to the fixed arrays if the block cannot be had.  */
+
+bool reserve_search_workspace(int nvertices) {
+
+   char *block;
+   size_t n;
+
+   if (nvertices > MAX_SEARCH_V) return(false);
+
+   if (nvertices > search_block.nvertices && (nvertices > MAXV || memory_placement_set())) {
+      if (nvertices < MAXV) nvertices = MAXV;  /* one block for every small graph */
+      n = nvertices + 1;
+      block = (char *) memory_allocate_placed(MEM_SEARCH, n * (2*sizeof(int) + 3*sizeof(bool)));
+      if (block != NULL) {
+         memory_free(MEM_SEARCH, search_block.block);
+         search_block.block = block;
+         search_block.nvertices = nvertices;
+      }
+   }
+
+   if (search_block.block == NULL || search_block.nvertices < nvertices) {
+      if (nvertices > MAXV) return(false);
+      processed = small_processed;
+      discovered = small_discovered;
+      parent = small_parent;
+      intree = small_intree;
+      distance = small_distance;
+      return(true);
+   }
+
+   n = search_block.nvertices + 1;
+   block = (char *) search_block.block;
+   parent = (int *) block;
+   distance = (int *) (block + n * sizeof(int));
+   processed = (bool *) (block + n * 2*sizeof(int));
+   discovered = processed + n;
+   intree = discovered + n;
+   return(true);
+}
+
 /* Each vertex is initialized as undiscovered:                      */
 
 void initialize_search(graph *g){
         
    int i;                          /* counter */
    
+   if (!reserve_search_workspace(g->nvertices)) return;
+
    for (i=1; i<=g->nvertices; i++) {
       processed[i] = discovered[i] = FALSE;
       parent[i] = -1;
    } 
 }
 
+/* copy the parent of each vertex found by the last bfs() or prim()  */
+/* on this thread; -1 for the root and for vertices not reached      */
+
+void get_search_parents(graph *g, int parents[]) {
+
+   int i;                          /* counter */
+
+   for (i=1; i<=g->nvertices; i++)
+      parents[i] = (parent != NULL) ? parent[i] : -1;
+}
+
+/* bytes of statically allocated search state, for memory reporting; */
+/* a grid search's workspace is charged when it is allocated          */
+
+size_t search_workspace_bytes() {
+   return(sizeof(small_processed) + sizeof(small_discovered) + sizeof(small_parent)
+          + sizeof(small_intree) + sizeof(small_distance));
+}
+
+/* Grid maps                                                        */
+/*                                                                  */
+/* Cell (x, y), with x the row and y the column counting from 0, is  */
+/* vertex x * map_dimension_y + y + 1.                               */
+
+int get_graph_vertex_number(int map_column_size, int cell_index_x, int cell_index_y) {
+   return(cell_index_x * map_column_size + cell_index_y + 1);
+}
+
+int convert_vertex_to_map_x_cordinates(int map_dimension_y, int vertex_number) {
+   return((vertex_number - 1) / map_dimension_y);
+}
+
+int convert_vertex_to_map_y_cordinates(int map_dimension_y, int vertex_number) {
+   return((vertex_number - 1) % map_dimension_y);
+}
+
+/* read a map_dimension_x by map_dimension_y map of cell capacities, row by row */
+
+void read_map(FILE *fp_in, int map[][MAX_M], int map_dimension_x, int map_dimension_y) {
+
+   int i, j;                       /* counters */
+
+   for (i=0; i<map_dimension_x; i++)
+      for (j=0; j<map_dimension_y; j++)
+         if (fscanf(fp_in, "%d", &map[i][j]) != 1) map[i][j] = 0;
+}
+
+/* Read one tile of a raster too large to hold at once. The raster  */
+/* is a binary file of ints, row by row, raster_dimension_y columns  */
+/* wide; the tile's top-left cell is (tile_x, tile_y). Only the      */
+/* rows of the tile are read, each with a single seek.               */
+
+bool read_map_tile(FILE *fp_raster, int map[][MAX_M], int raster_dimension_y, int tile_x, int tile_y, int tile_dimension_x, int tile_dimension_y) {
+
+   int i;                          /* counter */
+   long offset;                    /* of the tile row in the file */
+
+   if (tile_dimension_x > MAX_N || tile_dimension_y > MAX_M) return(false);
+   if (tile_y + tile_dimension_y > raster_dimension_y) return(false);
+
+   for (i=0; i<tile_dimension_x; i++) {
+      offset = ((long) (tile_x + i) * raster_dimension_y + tile_y) * (long) sizeof(int);
+      if (fseek(fp_raster, offset, SEEK_SET) != 0) return(false);
+      if (fread(map[i], sizeof(int), tile_dimension_y, fp_raster) != (size_t) tile_dimension_y)
+         return(false);
+   }
+   return(true);
+}
+
+/* Make g the implicit grid graph of a map; no edges are stored, so  */
+/* the map must outlive g. Grid graphs are undirected. A search of   */
+/* g takes a tracked workspace of about 11 bytes per cell, and the   */
+/* route arrays passed to find_path() must hold one entry per cell.  */
+
+void map_to_graph(graph *g, bool directed, int map[][MAX_M], int map_dimension_x, int map_dimension_y) {
+
+   initialize_graph(g, directed);
+
+   g->grid.cells = map;
+   g->grid.dim_x = map_dimension_x;
+   g->grid.dim_y = map_dimension_y;
+   g->nvertices = map_dimension_x * map_dimension_y;
+}
+
+/* advance e to the next open neighbour of e->v: up, left, right, down */
+
+bool next_grid_edge(graph *g, edge_iterator *e) {
+
+   static const int dx[4] = {-1, 0, 0, 1};
+   static const int dy[4] = {0, -1, 1, 0};
+   int x, y;                       /* cell of e->v     */
+   int nx, ny;                     /* neighbour cell   */
+   int capacity;                   /* of the e->v cell */
+
+   x = convert_vertex_to_map_x_cordinates(g->grid.dim_y, e->v);
+   y = convert_vertex_to_map_y_cordinates(g->grid.dim_y, e->v);
+   capacity = g->grid.cells[x][y];
+   if (capacity <= 0) return(false);
+
+   while (e->direction < 4) {
+      nx = x + dx[e->direction];
+      ny = y + dy[e->direction];
+      e->direction++;
+
+      if (nx < 0 || nx >= g->grid.dim_x || ny < 0 || ny >= g->grid.dim_y) continue;
+      if (g->grid.cells[nx][ny] <= 0) continue;
+
+      e->y = get_graph_vertex_number(g->grid.dim_y, nx, ny);
+      e->weight = (g->grid.cells[nx][ny] < capacity) ? g->grid.cells[nx][ny] : capacity;
+      return(true);
+   }
+   return(false);
+}
+
 /* Once a vertex is discovered, it is placed on a queue.           */
 /* Since we process these vertices in first-in, first-out order,   */
 /* the oldest vertices are expanded first, which are exactly those */
@@ -172,75 +784,48 @@ void bfs(graph *g, int start)
    queue q;                  /* queue of vertices to visit */
    int v;                    /* current vertex             */
    int y;                    /* successor vertex           */
-   edgenode *p;              /* temporary pointer          */
+   edge_iterator e;          /* edges of v                 */
+   bool more;                /* e holds an edge            */
+
+   if (!reserve_search_workspace(g->nvertices)) return;
 
    init_queue(&q);
    enqueue(&q,start);
    discovered[start] = TRUE;
    while (empty_queue(&q) == FALSE) {
       v = dequeue(&q);
+      TRACE_VERTEX_SETTLE(v, parent[v]);
       process_vertex_early(v);
       processed[v] = TRUE;
-      p = g->edges[v];
 
-      while (p != NULL) {  
+      for (more = first_edge(g, v, &e); more; more = next_edge(g, &e)) {
          
-         y = p->y;
+         y = e.y;
          if ((processed[y] == FALSE) || g->directed)
             process_edge(v,y);
          if (discovered[y] == FALSE) {
             enqueue(&q,y);
             discovered[y] = TRUE;
             parent[y] = v;
+            TRACE_EDGE_RELAX(v, y, e.weight);
          }
-
-         p = p->next; 
       }
       process_vertex_late(v);
    }
 }
 
-/* The exact behaviour of bfs depends on the functions             */
-/*    process vertex early()                                       */
-/*    process vertex late()                                        */
-/*    process edge()                                               */
-/* These functions allow us to customize what the traversal does   */
-/* as it makes its official visit to each edge and each vertex.    */
-/* Here, e.g., we will do all of vertex processing on entry        */
-/* (to print each vertex and edge exactly once)                    */
-/* so process vertex late() returns without action                 */
-
-void process_vertex_late(int v) {
-	//printf("processed vertex %d\n",v);
-}
-
-void process_vertex_early(int v){
-   //printf("processed vertex %d\n",v);
-}
-
-void process_edge(int x, int y) {
-   //printf("processed edge (%d,%d)\n",x,y);
-}
-
-/* this version just counts the number of edges                     */
-/*
-void process_edge(int x, int y) {
-   nedges = nedges + 1;
-}
-*/
-
 int get_weight_between_parent_and_vertex(graph *g, int parent, int vertex){
 
-	edgenode *p;
+	edge_iterator e;
+	bool more;
 	int next_vertex;   /* candidate next vertex */
 	int weight;
 	int found_weight;
-	p = g->edges[vertex];
 
-	while (p != NULL) {
+	for (more = first_edge(g, vertex, &e); more; more = next_edge(g, &e)) {
 
-		next_vertex = p->y;
-		weight = p->weight;
+		next_vertex = e.y;
+		weight = e.weight;
 
 		//printf("found this wait for %d", weight);
 
@@ -250,7 +835,6 @@ int get_weight_between_parent_and_vertex(graph *g, int parent, int vertex){
 
 			found_weight = weight;
 		}
-		p = p->next;
 	}
 
 	return found_weight;
@@ -316,6 +900,10 @@ bool find_path_modified(int start, int end, int parents[], graph *g, int *optima
  
 /* DV abstract version that hides implementation by removing the parent array from the parameter list */
 /* leaving only parameters that can be passed as arguments from the application code                  */
+/*                                                                                                    */
+/* A route visits each vertex at most once, so optimal_max_weight_array and best_route_array must     */
+/* hold g->nvertices entries: MAXV for a stored graph, up to MAX_SEARCH_V for a grid map's graph.     */
+/* Returns false, as for no path, if a grid graph's search workspace cannot be allocated.             */
 
 bool find_path(graph *g, int start, int end, int *optimal_max_weight_array, int *num_elements, int *best_route_array, int *best_route_counter) {
    bool is_path;
@@ -332,9 +920,12 @@ bool find_path(graph *g, int start, int end, int *optimal_max_weight_array, int
          printf("Invalid end vertex\n");
       is_path = false;
    }
+   else if (!reserve_search_workspace(g->nvertices)) {
+      is_path = false;
+   }
    else {
       initialize_search(g);
-      prim(g, start);
+      spanning_tree(g, start);
 	  is_path = find_path_modified(start, end, parent, g, optimal_max_weight_array, num_elements, best_route_array, best_route_counter);
       //is_path = find_path(start, end, parent); // now call the version of find_path that has the parent array as an argument
       if (debug) printf("\n");
@@ -443,38 +1034,40 @@ void prompt_and_exit(int status) {
 void prim(graph *g, int start) {
 
 	int i; /* counter */
-	edgenode *p; /* temporary pointer */
-
-	bool intree[MAXV+1]; /* is the vertex in the tree yet? */
-	int distance[MAXV+1]; /* cost of adding to tree */
+	edge_iterator e; /* edges of the current vertex */
+	bool more; /* e holds an edge */
 
 	int v; /* current vertex to process */
 	int w; /* candidate next vertex */
 	int weight; /* edge weight */
 	int dist; /* best current distance from start */
 
+	if (!reserve_search_workspace(g->nvertices)) return;
+
 	for (i=1; i<=g->nvertices; i++) {
 		intree[i] = FALSE;
 		distance[i] = MAXINT; //change this later
 		parent[i] = -1;
 	}
 
+	TRACE_TREE_START(start, g->nvertices);
+
 	distance[start] = 0;
 	v = start;
 
 	while (intree[v] == FALSE) {
 		intree[v] = TRUE;
-		p = g->edges[v];
+		TRACE_VERTEX_SETTLE(v, parent[v]);
 
-		while (p != NULL) {
-			w = p->y;
-			weight = p->weight;
+		for (more = first_edge(g, v, &e); more; more = next_edge(g, &e)) {
+			w = e.y;
+			weight = e.weight;
 
 			if ((distance[w] < weight) && (intree[w] == FALSE)) {
 				distance[w] = weight;
 				parent[w] = v;
+				TRACE_EDGE_RELAX(v, w, weight);
 			}
-			p = p->next;
 		}
 
 		v = 1;
@@ -486,6 +1079,144 @@ void prim(graph *g, int start) {
 			v = i;
 		}
 	}
+
+	TRACE_TREE_END(start, g->nvertices);
+}
+
+/* Kruskal's algorithm for small integer weights: the edges are      */
+/* bucket sorted by weight in O(E + W) and joined heaviest first,    */
+/* stopping once V-1 have been accepted. The parent[] of the tree    */
+/* is then oriented from start by a walk over the accepted edges,    */
+/* as prim() leaves it. Like prim(), edges of weight <= 0 are not    */
+/* used. Falls back to prim() if the buckets cannot be allocated.    */
+
+void kruskal(graph *g, int start) {
+
+	int i, k; /* counters */
+	edge_iterator e; /* edges of the current vertex */
+	bool more; /* e holds an edge */
+
+	int n = g->nvertices;
+	int nweights = g->max_weight; /* buckets 1 .. nweights */
+	int *bucket; /* next slot for each weight, heaviest first */
+	int *from, *to; /* edges in order of decreasing weight */
+	int m = 0; /* edges sorted */
+
+	int uf_parent[MAXV+1], uf_size[MAXV+1]; /* forest built so far */
+	int tree_x[MAXV], tree_y[MAXV]; /* accepted edges */
+	int accepted = 0;
+	int order[MAXV+1]; /* walk from start */
+	int head, tail;
+	int v, w;
+
+	if (n > MAXV || nweights <= 0) {
+		prim(g, start);
+		return;
+	}
+	reserve_search_workspace(n);
+
+	bucket = (int *) memory_allocate(MEM_SEARCH, (nweights + 2) * sizeof(int));
+	if (bucket == NULL) {
+		prim(g, start);
+		return;
+	}
+
+	/* count each undirected edge once, under its smaller endpoint */
+
+	for (k=0; k<=nweights+1; k++) bucket[k] = 0;
+	for (v=1; v<=n; v++)
+		for (more = first_edge(g, v, &e); more; more = next_edge(g, &e))
+			if (v < e.y && e.weight > 0) {
+				bucket[e.weight]++;
+				m++;
+			}
+
+	from = (int *) memory_allocate(MEM_SEARCH, (m + 1) * sizeof(int));
+	to = (int *) memory_allocate(MEM_SEARCH, (m + 1) * sizeof(int));
+	if (from == NULL || to == NULL) {
+		memory_free(MEM_SEARCH, bucket);
+		memory_free(MEM_SEARCH, from);
+		memory_free(MEM_SEARCH, to);
+		prim(g, start);
+		return;
+	}
+
+	TRACE_TREE_START(start, n);
+
+	/* turn counts into the first slot of each weight, heaviest first */
+
+	for (k=nweights, i=0; k>=1; k--) {
+		w = bucket[k];
+		bucket[k] = i;
+		i += w;
+	}
+
+	for (v=1; v<=n; v++)
+		for (more = first_edge(g, v, &e); more; more = next_edge(g, &e))
+			if (v < e.y && e.weight > 0) {
+				i = bucket[e.weight]++;
+				from[i] = v;
+				to[i] = e.y;
+			}
+
+	uf_init(uf_parent, uf_size, n);
+	for (i=0; i<m && accepted < n-1; i++) {
+		if (uf_union(uf_parent, uf_size, from[i], to[i])) {
+			tree_x[accepted] = from[i];
+			tree_y[accepted] = to[i];
+			accepted++;
+		}
+	}
+
+	/* orient the tree containing start */
+
+	for (i=1; i<=n; i++)
+		parent[i] = -1;
+
+	head = tail = 0;
+	order[tail++] = start;
+	while (head < tail) {
+		v = order[head++];
+		TRACE_VERTEX_SETTLE(v, parent[v]);
+		for (k=0; k<accepted; k++) {
+			if (tree_x[k] == v) w = tree_y[k];
+			else if (tree_y[k] == v) w = tree_x[k];
+			else continue;
+			if (w == start || parent[w] != -1) continue;
+			parent[w] = v;
+			order[tail++] = w;
+		}
+	}
+
+	memory_free(MEM_SEARCH, bucket);
+	memory_free(MEM_SEARCH, from);
+	memory_free(MEM_SEARCH, to);
+
+	TRACE_TREE_END(start, n);
+}
+
+static bool kruskal_enabled = false; /* see set_spanning_tree_kruskal */
+
+/* Let spanning_tree() use kruskal(). Off by default: kruskal() may   */
+/* pick a different tree than prim() among roads of equal capacity,   */
+/* and so a different route. Set it before any thread is started.     */
+
+void set_spanning_tree_kruskal(bool enabled) {
+	kruskal_enabled = enabled;
+}
+
+/* Build the maximum spanning tree from start into parent[], with    */
+/* kruskal() if it is enabled and the weights are few enough, next to */
+/* the number of edges, for its buckets to pay off, and with prim()   */
+/* otherwise; directed and grid graphs always use prim()              */
+
+void spanning_tree(graph *g, int start) {
+
+	if (kruskal_enabled && !g->directed && g->grid.cells == NULL && g->max_weight > 0
+	    && g->max_weight <= COUNTING_SORT_MAX_WEIGHT && g->max_weight <= g->nedges)
+		kruskal(g, start);
+	else
+		prim(g, start);
 }
 int get_minimum_element(int *my_array, int num_elements){
 
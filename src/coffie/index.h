@@ -0,0 +1,58 @@
+/* 
+  Interface file
+
+  Scenario offset index - the byte offset and size of every scenario in an
+  input file, so that a single scenario, or a range of them, can be solved
+  without parsing everything before it, and a large batch can be split
+  across independent processes.
+
+  The index is kept next to the input, e.g. input.txt.idx, in a binary file:
+
+     int        SCENARIO_INDEX_MAGIC
+     int        number of scenarios
+     long long  size of the input file in bytes    } to detect a
+     long long  its modification time, in seconds  } stale index
+     long long  offset just after the last scenario
+     then for each scenario
+        long long  offset of its header, as returned by ftell()
+        int        number of vertices
+        int        number of edges
+
+  An input rewritten within the same second and to the same size is still
+  caught: seek_scenario() reads the header at the offset it seeks to and
+  fails unless it matches the entry, and the index is then rebuilt.
+
+*/
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "graph.h"
+
+#define SCENARIO_INDEX_MAGIC 0x32444953   /* "SID2" */
+
+typedef struct {
+   long long offset;             /* where fscanf() of the header starts */
+   int num_vertices;
+   int num_edges;
+} scenario_index_entry;
+
+typedef struct {
+   int nscenarios;
+   long long input_size;         /* bytes in the indexed input   */
+   long long input_mtime;        /* and when it was last written */
+   long long end_offset;         /* just after the last scenario */
+   scenario_index_entry *entry;  /* entry[0] is scenario 1       */
+} scenario_index;
+
+bool build_scenario_index(FILE *fp_in, scenario_index *index);
+
+bool write_scenario_index(const char *path, scenario_index *index);
+
+bool load_scenario_index(const char *path, FILE *fp_in, scenario_index *index);
+
+bool seek_scenario(FILE *fp_in, scenario_index *index, int scenario);
+
+void free_scenario_index(scenario_index *index);
+
+#endif
@@ -0,0 +1,198 @@
+/* 
+
+  Implementation file
+
+  Scenario offset index - see index.h
+
+  Building the index does not parse numbers: after each header the
+  3 * (edges + 1) tokens of the scenario are skipped by looking only at
+  whitespace, which is several times quicker than fscanf().
+
+*/
+
+#include <sys/stat.h>
+
+#include "index.h"
+
+/* bytes in the file, leaving the position unchanged */
+
+static long long file_size(FILE *fp) {
+
+   long position = ftell(fp);
+   long long size;
+
+   if (fseek(fp, 0, SEEK_END) != 0) return(-1);
+   size = ftell(fp);
+   fseek(fp, position, SEEK_SET);
+   return(size);
+}
+
+/* modification time of the file in seconds, -1 if unknown */
+
+static long long file_mtime(FILE *fp) {
+
+   struct stat st;
+
+   if (fstat(fileno(fp), &st) != 0) return(-1);
+   return((long long) st.st_mtime);
+}
+
+/* skip n whitespace-separated tokens; false if the file ends first */
+
+static bool skip_tokens(FILE *fp, long long n) {
+
+   int c;
+   bool in_token = false;
+
+   while (n > 0) {
+      c = getc(fp);
+      if (c == EOF) return(in_token && n == 1);
+      if (isspace(c)) {
+         if (in_token) n--;
+         in_token = false;
+      }
+      else {
+         in_token = true;
+      }
+   }
+   return(true);
+}
+
+/* add an entry, doubling the array when it is full */
+
+static bool append_entry(scenario_index *index, int *capacity, scenario_index_entry *entry) {
+
+   scenario_index_entry *larger;
+   int size;
+
+   if (index->nscenarios == *capacity) {
+      size = (*capacity > 0) ? 2 * *capacity : 256;
+      larger = (scenario_index_entry *) memory_allocate(MEM_IO, size * sizeof(scenario_index_entry));
+      if (larger == NULL) return(false);
+      if (index->nscenarios > 0)
+         memcpy(larger, index->entry, index->nscenarios * sizeof(scenario_index_entry));
+      memory_free(MEM_IO, index->entry);
+      index->entry = larger;
+      *capacity = size;
+   }
+   index->entry[index->nscenarios++] = *entry;
+   return(true);
+}
+
+/* Index every scenario of fp_in, which is read from the start and   */
+/* left at the end of the last scenario. Return false if there is    */
+/* not enough memory.                                                */
+
+bool build_scenario_index(FILE *fp_in, scenario_index *index) {
+
+   scenario_index_entry entry;
+   int capacity = 0;             /* entries allocated */
+
+   index->nscenarios = 0;
+   index->entry = NULL;
+   index->input_size = file_size(fp_in);
+   index->input_mtime = file_mtime(fp_in);
+
+   rewind(fp_in);
+   index->end_offset = 0;
+
+   while (true) {
+      entry.offset = ftell(fp_in);
+      if (fscanf(fp_in, "%d %d", &entry.num_vertices, &entry.num_edges) != 2) break;
+      if (entry.num_vertices == 0 && entry.num_edges == 0) break;
+
+      //edges, then the start, destination and number of passengers
+      if (!skip_tokens(fp_in, 3 * ((long long) entry.num_edges + 1))) break;
+      if (!append_entry(index, &capacity, &entry)) {
+         free_scenario_index(index);
+         return(false);
+      }
+      index->end_offset = ftell(fp_in);
+   }
+   return(true);
+}
+
+bool write_scenario_index(const char *path, scenario_index *index) {
+
+   FILE *fp;
+   int header[2];
+   bool ok;
+
+   if ((fp = fopen(path, "wb")) == NULL) return(false);
+
+   header[0] = SCENARIO_INDEX_MAGIC;
+   header[1] = index->nscenarios;
+   ok = fwrite(header, sizeof(int), 2, fp) == 2 &&
+        fwrite(&index->input_size, sizeof(long long), 1, fp) == 1 &&
+        fwrite(&index->input_mtime, sizeof(long long), 1, fp) == 1 &&
+        fwrite(&index->end_offset, sizeof(long long), 1, fp) == 1 &&
+        fwrite(index->entry, sizeof(scenario_index_entry), index->nscenarios, fp) == (size_t) index->nscenarios;
+
+   if (fclose(fp) != 0) ok = false;
+   return(ok);
+}
+
+/* Load the index at path; false if it is missing, damaged or was    */
+/* built from a different version of fp_in                          */
+
+bool load_scenario_index(const char *path, FILE *fp_in, scenario_index *index) {
+
+   FILE *fp;
+   int header[2];
+   bool ok;
+
+   index->nscenarios = 0;
+   index->entry = NULL;
+
+   if ((fp = fopen(path, "rb")) == NULL) return(false);
+
+   ok = fread(header, sizeof(int), 2, fp) == 2 && header[0] == SCENARIO_INDEX_MAGIC && header[1] >= 0 &&
+        fread(&index->input_size, sizeof(long long), 1, fp) == 1 &&
+        fread(&index->input_mtime, sizeof(long long), 1, fp) == 1 &&
+        fread(&index->end_offset, sizeof(long long), 1, fp) == 1 &&
+        index->input_size == file_size(fp_in) && index->input_mtime == file_mtime(fp_in);
+
+   if (ok && header[1] > 0) {
+      index->entry = (scenario_index_entry *) memory_allocate(MEM_IO, header[1] * sizeof(scenario_index_entry));
+      ok = index->entry != NULL &&
+           fread(index->entry, sizeof(scenario_index_entry), header[1], fp) == (size_t) header[1];
+   }
+   if (ok) index->nscenarios = header[1];
+   else free_scenario_index(index);
+
+   fclose(fp);
+   return(ok);
+}
+
+/* Position fp_in at the header of a scenario, numbered from 1; past  */
+/* the last scenario, position it where the input ends. Return false */
+/* if the header found there is not the one indexed, i.e. the index  */
+/* is stale, and then leave the position unspecified.                */
+
+bool seek_scenario(FILE *fp_in, scenario_index *index, int scenario) {
+
+   long long offset;
+   int num_vertices, num_edges;  /* header found at offset */
+   int n;
+
+   if (scenario < 1) return(false);
+   offset = (scenario <= index->nscenarios) ? index->entry[scenario-1].offset : index->end_offset;
+   if (fseek(fp_in, (long) offset, SEEK_SET) != 0) return(false);
+
+   n = fscanf(fp_in, "%d %d", &num_vertices, &num_edges);
+   if (scenario <= index->nscenarios) {
+      if (n != 2 || num_vertices != index->entry[scenario-1].num_vertices ||
+          num_edges != index->entry[scenario-1].num_edges) return(false);
+   }
+   else {                        /* only the "0 0" terminator, if anything */
+      if (n != EOF && (n != 2 || num_vertices != 0 || num_edges != 0)) return(false);
+   }
+   return(fseek(fp_in, (long) offset, SEEK_SET) == 0);
+}
+
+void free_scenario_index(scenario_index *index) {
+
+   memory_free(MEM_IO, index->entry);
+   index->entry = NULL;
+   index->nscenarios = 0;
+}
@@ -0,0 +1,63 @@
+/* 
+  Interface file
+
+  Memory accounting - tracked allocation with per-subsystem current and
+  peak usage, and an optional budget so that a scenario which would need
+  more memory than allowed fails cleanly instead of taking down the process
+
+*/
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "stdio.h"
+#include "stdlib.h"
+
+/* subsystems that memory is charged to */
+
+#define MEM_GRAPH       0        /* edgenode lists and graph storage */
+#define MEM_SEARCH      1        /* search workspaces                */
+#define MEM_CACHE       2        /* caches and lookup tables         */
+#define MEM_IO          3        /* input and output buffers         */
+#define MEM_SUBSYSTEMS  4
+
+/* placement of large blocks, see set_memory_placement() */
+
+#define PAGES_NORMAL       0     /* ordinary heap allocation               */
+#define PAGES_TRANSPARENT  1     /* mapped and advised for huge pages      */
+#define PAGES_EXPLICIT     2     /* reserved huge pages, else transparent  */
+
+#define NUMA_DEFAULT      -1     /* first touch                            */
+#define NUMA_INTERLEAVE   -2     /* round robin over all nodes             */
+                                 /* 0, 1, ...: bind to that node           */
+
+#define PLACEMENT_MIN_BYTES (1 << 20)  /* smaller blocks use the heap, unless */
+                                       /* memory_allocate_placed() is used     */
+
+void *memory_allocate(int subsystem, size_t bytes);
+
+void *memory_allocate_placed(int subsystem, size_t bytes);
+
+void memory_free(int subsystem, void *block);
+
+void memory_track_static(int subsystem, size_t bytes);
+
+bool set_memory_placement(int pages, int numa_node);
+
+bool memory_placement_set();
+
+void set_memory_budget(size_t bytes);
+
+size_t get_memory_budget();
+
+bool memory_budget_exceeded();
+
+void clear_memory_budget_exceeded();
+
+size_t get_current_memory(int subsystem);
+
+size_t get_peak_memory(int subsystem);
+
+void print_memory_report(FILE *fp);
+
+#endif
@@ -0,0 +1,289 @@
+/* 
+
+  Implementation file
+
+  Memory accounting - see memory.h
+
+  Every tracked block carries a small header recording its size so that
+  memory_free() can credit the right number of bytes back to its subsystem.
+  A budget of zero means unlimited.  Counters are atomic because the
+  pipeline's reader, solver and writer threads allocate concurrently.
+
+  With a placement set, blocks of PLACEMENT_MIN_BYTES or more, and blocks
+  of any size from memory_allocate_placed(), are mapped directly instead,
+  so that they can be backed by huge pages and given a NUMA policy before
+  any page is touched; the header records the length
+  of the mapping so that memory_free() knows to unmap it.  Mapped blocks
+  are charged their full, page-rounded length; only blocks of at least
+  HUGE_PAGE_BYTES are rounded to explicit huge pages, so a small block
+  never costs a whole huge page.
+
+*/
+
+#include <atomic>
+
+#include "memory.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#define HUGE_PAGE_BYTES (2 << 20)
+
+typedef union {
+   struct {
+      size_t bytes;              /* size of the user block, with header */
+      size_t mapped;             /* length of its mapping, 0 if on heap */
+   } size;
+   long double align;            /* keep the user block well aligned */
+} memory_header;
+
+static const char *subsystem_names[MEM_SUBSYSTEMS] = {"graph", "search", "cache", "io"};
+
+static std::atomic<size_t> current_bytes[MEM_SUBSYSTEMS];  /* bytes in use now        */
+static std::atomic<size_t> peak_bytes[MEM_SUBSYSTEMS];     /* high-water mark         */
+static std::atomic<size_t> total_bytes(0);                 /* sum over all subsystems */
+static std::atomic<size_t> total_peak_bytes(0);
+static size_t budget_bytes = 0;                            /* 0 means no budget       */
+static std::atomic<bool> budget_exceeded(false);           /* sticky failure flag     */
+
+static int placement_pages = PAGES_NORMAL;                 /* see set_memory_placement */
+static int placement_node = NUMA_DEFAULT;
+static std::atomic<size_t> mapped_blocks(0);               /* large blocks mapped      */
+static std::atomic<size_t> huge_blocks(0);                 /* of which on huge pages   */
+
+static void raise_peak(std::atomic<size_t> *peak, size_t value) {
+
+   size_t seen = peak->load();
+
+   while (value > seen && !peak->compare_exchange_weak(seen, value))
+      ;
+}
+
+static void charge(int subsystem, size_t bytes) {
+
+   raise_peak(&peak_bytes[subsystem], current_bytes[subsystem] += bytes);
+   raise_peak(&total_peak_bytes, total_bytes += bytes);
+}
+
+static size_t round_up(size_t bytes, size_t unit) {
+   return((bytes + unit - 1) / unit * unit);
+}
+
+/* Map length bytes for a large block, following the placement; NULL */
+/* on failure. *huge is set if explicit huge pages were obtained.     */
+
+static void *map_block(size_t length, bool *huge) {
+
+#ifdef _WIN32
+   *huge = false;
+   return(NULL);
+#else
+   void *block = MAP_FAILED;
+
+   *huge = false;
+
+#ifdef MAP_HUGETLB
+   if (placement_pages == PAGES_EXPLICIT && length % HUGE_PAGE_BYTES == 0) {
+      block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      *huge = (block != MAP_FAILED);
+   }
+#endif
+
+   /* no reserved huge pages: fall back to ordinary, perhaps transparent, pages */
+
+   if (block == MAP_FAILED)
+      block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (block == MAP_FAILED) return(NULL);
+
+#ifdef MADV_HUGEPAGE
+   if (!*huge && placement_pages != PAGES_NORMAL)
+      madvise(block, length, MADV_HUGEPAGE);
+#endif
+
+   /* the policy must be set before the first touch */
+
+#ifdef HAVE_LIBNUMA
+   if (placement_node == NUMA_INTERLEAVE)
+      numa_interleave_memory(block, length, numa_all_nodes_ptr);
+   else if (placement_node >= 0)
+      numa_tonode_memory(block, length, placement_node);
+#endif
+
+   return(block);
+#endif
+}
+
+/* Allocate bytes charged to subsystem, mapping them as placed if   */
+/* there are at least min_placed; NULL if the budget would be       */
+/* exceeded                                                         */
+
+static void *allocate(int subsystem, size_t bytes, size_t min_placed) {
+
+   memory_header *h = NULL;      /* header in front of the user block */
+   size_t needed;                /* bytes including the header        */
+   size_t total;                 /* total in use including this block */
+   size_t mapped = 0;            /* length of the mapping, if mapped  */
+   size_t unit;                  /* page size the mapping rounds to   */
+   bool huge;                    /* mapped on explicit huge pages     */
+
+   needed = bytes + sizeof(memory_header);
+
+#ifndef _WIN32
+   if (memory_placement_set() && bytes >= min_placed) {
+      unit = (placement_pages == PAGES_EXPLICIT && needed >= HUGE_PAGE_BYTES) ? HUGE_PAGE_BYTES : (size_t) sysconf(_SC_PAGESIZE);
+      mapped = round_up(needed, unit);
+      needed = mapped;
+   }
+#endif
+
+   /* reserve first so that concurrent allocations cannot overshoot */
+
+   total = (total_bytes += needed);
+   if ((budget_bytes > 0) && (total > budget_bytes)) {
+      total_bytes -= needed;
+      budget_exceeded = true;
+      return(NULL);
+   }
+
+   if (mapped > 0) {
+      h = (memory_header *) map_block(mapped, &huge);
+      if (h != NULL) {
+         mapped_blocks++;
+         if (huge) huge_blocks++;
+      }
+   }
+   else {
+      h = (memory_header *) malloc(needed);
+   }
+
+   if (h == NULL) {
+      total_bytes -= needed;
+      budget_exceeded = true;
+      return(NULL);
+   }
+
+   h->size.bytes = needed;
+   h->size.mapped = mapped;
+   raise_peak(&total_peak_bytes, total);
+   raise_peak(&peak_bytes[subsystem], current_bytes[subsystem] += needed);
+   return((void *) (h + 1));
+}
+
+/* allocate bytes charged to subsystem; NULL if the budget would be exceeded */
+
+void *memory_allocate(int subsystem, size_t bytes) {
+   return(allocate(subsystem, bytes, PLACEMENT_MIN_BYTES));
+}
+
+/* As memory_allocate(), but the placement applies whatever the size: */
+/* for small, long-lived blocks read in inner loops, such as the      */
+/* per-thread search workspaces. Each takes at least a page.          */
+
+void *memory_allocate_placed(int subsystem, size_t bytes) {
+   return(allocate(subsystem, bytes, 0));
+}
+
+void memory_free(int subsystem, void *block) {
+
+   memory_header *h;
+
+   if (block == NULL) return;
+
+   h = ((memory_header *) block) - 1;
+   current_bytes[subsystem] -= h->size.bytes;
+   total_bytes -= h->size.bytes;
+#ifndef _WIN32
+   if (h->size.mapped > 0) {
+      munmap(h, h->size.mapped);
+      return;
+   }
+#endif
+   free(h);
+}
+
+/* record statically allocated storage so it appears in the report */
+
+void memory_track_static(int subsystem, size_t bytes) {
+   charge(subsystem, bytes);
+}
+
+/* Choose how blocks of PLACEMENT_MIN_BYTES or more are placed: the  */
+/* kind of pages, and NUMA_DEFAULT, NUMA_INTERLEAVE or a node to bind */
+/* to. Return false, leaving the placement unchanged, if this system   */
+/* cannot honour it.                                                  */
+
+bool set_memory_placement(int pages, int numa_node) {
+
+#ifdef _WIN32
+   if (pages != PAGES_NORMAL || numa_node != NUMA_DEFAULT) return(false);
+#endif
+
+   if (numa_node != NUMA_DEFAULT) {
+#ifdef HAVE_LIBNUMA
+      if (numa_available() < 0) return(false);
+      if (numa_node != NUMA_INTERLEAVE && (numa_node < 0 || numa_node > numa_max_node())) return(false);
+#else
+      return(false);
+#endif
+   }
+
+   placement_pages = pages;
+   placement_node = numa_node;
+   return(true);
+}
+
+/* true if blocks are being placed, i.e. not left to the heap */
+
+bool memory_placement_set() {
+   return(placement_pages != PAGES_NORMAL || placement_node != NUMA_DEFAULT);
+}
+
+void set_memory_budget(size_t bytes) {
+   budget_bytes = bytes;
+}
+
+size_t get_memory_budget() {
+   return(budget_bytes);
+}
+
+bool memory_budget_exceeded() {
+   return(budget_exceeded);
+}
+
+void clear_memory_budget_exceeded() {
+   budget_exceeded = false;
+}
+
+size_t get_current_memory(int subsystem) {
+   return(current_bytes[subsystem]);
+}
+
+size_t get_peak_memory(int subsystem) {
+   return(peak_bytes[subsystem]);
+}
+
+void print_memory_report(FILE *fp) {
+
+   int i;                        /* counter */
+
+   fprintf(fp, "Memory usage (bytes)   current        peak\n");
+   for (i=0; i<MEM_SUBSYSTEMS; i++) {
+      fprintf(fp, "  %-8s %17lu %11lu\n", subsystem_names[i],
+              (unsigned long) current_bytes[i].load(), (unsigned long) peak_bytes[i].load());
+   }
+   fprintf(fp, "  %-8s %17lu %11lu\n", "total",
+           (unsigned long) total_bytes.load(), (unsigned long) total_peak_bytes.load());
+
+   if (budget_bytes > 0)
+      fprintf(fp, "  budget   %17lu\n", (unsigned long) budget_bytes);
+
+   if (mapped_blocks > 0)
+      fprintf(fp, "  %lu large blocks mapped, %lu on reserved huge pages\n",
+              (unsigned long) mapped_blocks.load(), (unsigned long) huge_blocks.load());
+}
@@ -0,0 +1,45 @@
+/* 
+  Interface file
+
+  Pipelined scenario processing - a reader thread parses scenarios ahead of
+  the solver and a writer thread emits results behind it, connected by
+  bounded single-producer/single-consumer lock-free ring buffers.
+  Results are written in the same order as the scenarios in the input file.
+
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "scenario.h"
+
+#define PIPELINE_DEPTH  4        /* scenarios in flight at once        */
+#define RING_SIZE       8        /* ring capacity; power of two > depth */
+#define RING_SPINS      256      /* yields before a waiting stage blocks */
+
+/* single-producer/single-consumer queue of slot numbers; a stage that */
+/* has waited RING_SPINS yields sleeps on changed until the other side */
+/* moves                                                                */
+
+typedef struct {
+   std::atomic<unsigned> head;   /* next position to read, consumer owned  */
+   std::atomic<unsigned> tail;   /* next position to write, producer owned */
+   int item[RING_SIZE];
+   std::atomic<int> sleepers;    /* stages blocked on changed              */
+   std::mutex lock;              /* guards the sleep only, not the ring    */
+   std::condition_variable changed;
+} spsc_ring;
+
+void init_ring(spsc_ring *r);
+
+bool ring_push(spsc_ring *r, int x);
+
+bool ring_pop(spsc_ring *r, int *x);
+
+int run_pipeline(FILE *fp_in, FILE *fp_out, scenario_options *options);
+
+#endif
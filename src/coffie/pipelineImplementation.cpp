@@ -0,0 +1,178 @@
+/* 
+
+  Implementation file
+
+  Pipelined scenario processing - see pipeline.h
+
+  Scenario slots circulate through three rings:
+
+     free   : writer -> reader   slots that may be refilled
+     parsed : reader -> solver   slots holding a graph and query
+     solved : solver -> writer   slots holding formatted output
+
+  Each ring has exactly one producer and one consumer thread, so the only
+  synchronisation needed is an acquire/release pair on head and tail.
+  A slot number of -1 marks the end of the input; it only travels down
+  parsed and solved, so the writer stays the sole producer on free.
+
+  A stage that finds its ring full or empty yields for a while, then
+  sleeps on the ring's condition variable, so one waiting on disk I/O
+  does not keep a core busy. Whoever moves the ring wakes it: the
+  sleeper counts itself before its last try and the mover checks the
+  count after its move, with full fences between, so a wakeup is
+  never lost.
+
+*/
+
+#include <thread>
+
+#include "pipeline.h"
+
+void init_ring(spsc_ring *r) {
+
+   r->head.store(0, std::memory_order_relaxed);
+   r->tail.store(0, std::memory_order_relaxed);
+   r->sleepers.store(0, std::memory_order_relaxed);
+}
+
+/* return false if the ring is full */
+
+bool ring_push(spsc_ring *r, int x) {
+
+   unsigned tail = r->tail.load(std::memory_order_relaxed);
+
+   if (tail - r->head.load(std::memory_order_acquire) == RING_SIZE) return(false);
+
+   r->item[tail % RING_SIZE] = x;
+   r->tail.store(tail + 1, std::memory_order_release);
+   return(true);
+}
+
+/* return false if the ring is empty */
+
+bool ring_pop(spsc_ring *r, int *x) {
+
+   unsigned head = r->head.load(std::memory_order_relaxed);
+
+   if (r->tail.load(std::memory_order_acquire) == head) return(false);
+
+   *x = r->item[head % RING_SIZE];
+   r->head.store(head + 1, std::memory_order_release);
+   return(true);
+}
+
+/* wake the other side of r if it has gone to sleep */
+
+static void wake_ring(spsc_ring *r) {
+
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (r->sleepers.load() > 0) {
+      std::lock_guard<std::mutex> hold(r->lock);
+      r->changed.notify_all();
+   }
+}
+
+static void push_wait(spsc_ring *r, int x) {
+
+   int spins;
+
+   for (spins = 0; !ring_push(r, x); spins++) {
+      if (spins < RING_SPINS) {
+         std::this_thread::yield();
+         continue;
+      }
+      std::unique_lock<std::mutex> hold(r->lock);
+      r->sleepers++;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!ring_push(r, x)) r->changed.wait(hold);
+      r->sleepers--;
+      break;
+   }
+   wake_ring(r);
+}
+
+static int pop_wait(spsc_ring *r) {
+
+   int x;
+   int spins;
+
+   for (spins = 0; !ring_pop(r, &x); spins++) {
+      if (spins < RING_SPINS) {
+         std::this_thread::yield();
+         continue;
+      }
+      std::unique_lock<std::mutex> hold(r->lock);
+      r->sleepers++;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!ring_pop(r, &x)) r->changed.wait(hold);
+      r->sleepers--;
+      break;
+   }
+   wake_ring(r);
+   return(x);
+}
+
+static scenario_slot slots[PIPELINE_DEPTH];
+static spsc_ring free_ring, parsed_ring, solved_ring;
+
+static void reader_stage(FILE *fp_in, scenario_options *options) {
+
+   int scenario = options->first_scenario;  /* scenario number */
+   int k;                        /* slot being filled    */
+
+   while (options->last_scenario == 0 || scenario <= options->last_scenario) {
+      k = pop_wait(&free_ring);
+      slots[k].scenario = scenario;
+      if (!read_scenario(fp_in, &slots[k], options)) break;  /* the slot is simply left unused */
+      push_wait(&parsed_ring, k);
+      scenario += 1;
+   }
+   push_wait(&parsed_ring, -1);
+}
+
+static void writer_stage(FILE *fp_out) {
+
+   int k;                        /* slot being written */
+
+   while ((k = pop_wait(&solved_ring)) != -1) {
+      write_scenario(fp_out, &slots[k]);
+      push_wait(&free_ring, k);
+   }
+}
+
+/* Process every scenario in fp_in, writing results to fp_out;      */
+/* the solver runs on the calling thread.                           */
+/* Return the number of scenarios processed.                        */
+
+int run_pipeline(FILE *fp_in, FILE *fp_out, scenario_options *options) {
+
+   int k;                        /* slot number  */
+   int count = 0;                /* scenarios    */
+
+   init_ring(&free_ring);
+   init_ring(&parsed_ring);
+   init_ring(&solved_ring);
+
+   for (k=0; k<PIPELINE_DEPTH; k++) {
+      init_scenario_slot(&slots[k], options);
+      ring_push(&free_ring, k);
+   }
+
+   std::thread reader(reader_stage, fp_in, options);
+   std::thread writer(writer_stage, fp_out);
+
+   while ((k = pop_wait(&parsed_ring)) != -1) {
+      solve_scenario(&slots[k], options);
+      push_wait(&solved_ring, k);
+      count++;
+   }
+   push_wait(&solved_ring, -1);
+
+   reader.join();
+   writer.join();
+
+   for (k=0; k<PIPELINE_DEPTH; k++)
+      free_scenario_slot(&slots[k]);
+
+   return(count);
+}
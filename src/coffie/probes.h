@@ -0,0 +1,57 @@
+/* 
+  Interface file
+
+  Static tracepoints - USDT/SDT probes for investigating slow scenarios
+  with standard Linux tracing tools, e.g.
+
+     bpftrace -e 'usdt:./coffie:coffie:scenario_end { printf("%d\n", arg0); }'
+     perf probe -x ./coffie sdt_coffie:tree_start
+
+  Each probe is a single nop in the instruction stream, and its arguments
+  are left in registers, so nothing is paid unless a tracer attaches. The
+  arguments must therefore be cheap expressions with no side effects.
+
+  The probes are compiled in when <sys/sdt.h> (systemtap-sdt-dev) is found
+  at configuration time, which defines HAVE_SYS_SDT_H; otherwise they
+  expand to nothing.
+
+  Provider coffie:
+
+     scenario_start   scenario, vertices, edges
+     scenario_end     scenario, bytes of output
+     tree_start       start vertex, vertices
+     tree_end         start vertex, vertices
+     vertex_settle    vertex, parent
+     edge_relax       from, to, weight
+     route_emit       scenario, cities after the start, tourists per trip
+
+*/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define TRACE_SCENARIO_START(scenario, nvertices, nedges) DTRACE_PROBE3(coffie, scenario_start, scenario, nvertices, nedges)
+#define TRACE_SCENARIO_END(scenario, bytes)               DTRACE_PROBE2(coffie, scenario_end, scenario, bytes)
+#define TRACE_TREE_START(start, nvertices)                DTRACE_PROBE2(coffie, tree_start, start, nvertices)
+#define TRACE_TREE_END(start, nvertices)                  DTRACE_PROBE2(coffie, tree_end, start, nvertices)
+#define TRACE_VERTEX_SETTLE(v, parent)                    DTRACE_PROBE2(coffie, vertex_settle, v, parent)
+#define TRACE_EDGE_RELAX(x, y, weight)                    DTRACE_PROBE3(coffie, edge_relax, x, y, weight)
+#define TRACE_ROUTE_EMIT(scenario, hops, load)            DTRACE_PROBE3(coffie, route_emit, scenario, hops, load)
+
+#else
+
+#define TRACE_SCENARIO_START(scenario, nvertices, nedges)
+#define TRACE_SCENARIO_END(scenario, bytes)
+#define TRACE_TREE_START(start, nvertices)
+#define TRACE_TREE_END(start, nvertices)
+#define TRACE_VERTEX_SETTLE(v, parent)
+#define TRACE_EDGE_RELAX(x, y, weight)
+#define TRACE_ROUTE_EMIT(scenario, hops, load)
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+/* 
+  Interface file
+
+  Scenario processing - reading one test case from the input file, solving it
+  and formatting its result, split into separate steps so that reading,
+  solving and writing can run sequentially or as a pipeline
+
+*/
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include "graph.h"
+#include "external.h"
+#include "shard.h"
+#include "bottleneck.h"
+#include "dispatch.h"
+
+#define OUTPUT_BUFFER_SIZE 1024  /* initial size of a result buffer */
+
+/* growable text buffer holding the formatted result of a scenario */
+
+typedef struct {
+   char *text;                   /* formatted output, NUL terminated */
+   size_t length;                /* characters in use                */
+   size_t capacity;              /* bytes allocated                  */
+   bool truncated;               /* ran out of memory for the output */
+} output_buffer;
+
+/* run-wide settings chosen on the command line */
+
+typedef struct {
+   bool directed;                /* is the graph directed?            */
+   bool external;                /* build the spanning tree out of core */
+   bool compressed;              /* pack each graph after reading it    */
+   bool dispatch;                /* split tourists over several routes  */
+   shard_pool *shards;           /* worker pool, NULL to solve in process */
+   FILE *fp_table;               /* all-pairs bottleneck tables, or NULL  */
+   int first_scenario;           /* number of the first scenario read     */
+   int last_scenario;            /* stop after this one, 0 for no limit   */
+} scenario_options;
+
+/* everything needed to solve one scenario, independent of the file */
+
+typedef struct {
+   int scenario;                 /* scenario number, from 1          */
+   int num_vertices;
+   int num_edges;
+   vertex_id start_id;           /* query cities as given in the input */
+   vertex_id destination_id;
+   int start_city;               /* and as vertex numbers, 0 if absent */
+   int destination_city;
+   int total_number_tourists;
+   bool loaded;                  /* graph fitted in memory budget    */
+   bool temp_files_failed;       /* or -external had no temp files   */
+   graph g;
+   output_buffer out;
+} scenario_slot;
+
+void init_output_buffer(output_buffer *b);
+
+void reset_output_buffer(output_buffer *b);
+
+void free_output_buffer(output_buffer *b);
+
+void output_printf(output_buffer *b, const char *format, ...);
+
+void init_scenario_options(scenario_options *options);
+
+void init_scenario_slot(scenario_slot *s, scenario_options *options);
+
+void free_scenario_slot(scenario_slot *s);
+
+bool read_scenario(FILE *fp_in, scenario_slot *s, scenario_options *options);
+
+void solve_scenario(scenario_slot *s, scenario_options *options);
+
+void write_scenario(FILE *fp_out, scenario_slot *s);
+
+#endif
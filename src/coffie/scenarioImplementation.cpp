@@ -0,0 +1,351 @@
+/* 
+
+  Implementation file
+
+  Scenario processing - see scenario.h and assignment6Application.cpp for the
+  input and output formats
+
+*/
+
+#include <stdarg.h>
+
+#include "scenario.h"
+
+/* Result text is kept outside the memory budget: a scenario that     */
+/* does not fit must still be able to say so, so these buffers come   */
+/* straight from the heap and are not tracked.                        */
+
+void init_output_buffer(output_buffer *b) {
+
+   b->text = (char *) malloc(OUTPUT_BUFFER_SIZE);
+   b->capacity = (b->text == NULL) ? 0 : OUTPUT_BUFFER_SIZE;
+   reset_output_buffer(b);
+}
+
+void reset_output_buffer(output_buffer *b) {
+
+   b->length = 0;
+   b->truncated = false;
+   if (b->text != NULL) b->text[0] = '\0';
+}
+
+void free_output_buffer(output_buffer *b) {
+
+   free(b->text);
+   b->text = NULL;
+   b->capacity = 0;
+   b->length = 0;
+}
+
+/* append formatted text, doubling the buffer when it is full */
+
+void output_printf(output_buffer *b, const char *format, ...) {
+
+   va_list args;
+   int needed;                   /* characters to append */
+   size_t capacity;              /* new buffer size      */
+   char *text;                   /* new buffer           */
+
+   if (b->truncated) return;
+
+   va_start(args, format);
+   needed = vsnprintf(NULL, 0, format, args);
+   va_end(args);
+
+   if (b->length + needed + 1 > b->capacity) {
+      capacity = (b->capacity == 0) ? OUTPUT_BUFFER_SIZE : b->capacity;
+      while (b->length + needed + 1 > capacity) capacity *= 2;
+
+      text = (char *) realloc(b->text, capacity);
+      if (text == NULL) {
+         b->truncated = true;
+         return;
+      }
+      if (b->text == NULL) text[0] = '\0';
+      b->text = text;
+      b->capacity = capacity;
+   }
+
+   va_start(args, format);
+   vsnprintf(b->text + b->length, b->capacity - b->length, format, args);
+   va_end(args);
+   b->length += needed;
+}
+
+void init_scenario_options(scenario_options *options) {
+
+   options->directed = false;
+   options->external = false;
+   options->compressed = false;
+   options->dispatch = false;
+   options->shards = NULL;
+   options->fp_table = NULL;
+   options->first_scenario = 1;
+   options->last_scenario = 0;
+}
+
+void init_scenario_slot(scenario_slot *s, scenario_options *options) {
+
+   s->scenario = 0;
+   s->loaded = false;
+   s->temp_files_failed = false;
+   initialize_graph(&s->g, options->directed);
+   init_output_buffer(&s->out);
+}
+
+void free_scenario_slot(scenario_slot *s) {
+
+   free_graph(&s->g);
+   free_output_buffer(&s->out);
+}
+
+/* Read the next scenario: header, edges and the query line.        */
+/* Return false at end of file or on the terminating "0 0" header.  */
+/* The scenario number must be set by the caller.                   */
+
+bool read_scenario(FILE *fp_in, scenario_slot *s, scenario_options *options) {
+
+   int i;                        /* counter             */
+   vertex_id x, y;               /* discarded edge data */
+   int w;
+   int status;                   /* of the external reader */
+
+   if (fscanf(fp_in, "%d %d", &s->num_vertices, &s->num_edges) == EOF) return(false);
+
+   //break out of the loop or end program when we encounter 0 values for both cities and road segment
+   if (s->num_vertices == 0 && s->num_edges == 0) return(false);
+
+   //release the previous scenario's graph before loading the next one
+   free_graph(&s->g);
+
+   s->temp_files_failed = false;
+
+   //read the graph; graphs over the vertex limit are skipped, not stored
+   if (s->num_vertices > MAXV) {
+      for (i=0; i<s->num_edges; i++)
+         fscanf(fp_in, "%lld %lld %d", &x, &y, &w);
+      s->loaded = true;
+   }
+   else if (options->external) {
+      status = read_graph_external(fp_in, &s->g, s->num_vertices, s->num_edges);
+      s->loaded = (status == EXTERNAL_OK);
+      s->temp_files_failed = (status == EXTERNAL_NO_TEMP_FILE);
+   }
+   else {
+      s->loaded = read_graph_v2(fp_in, &s->g, options->directed, s->num_vertices, s->num_edges);
+   }
+
+   //a graph that cannot be packed is simply used as it is
+   if (options->compressed && s->loaded && s->num_vertices <= MAXV)
+      compress_graph(&s->g);
+
+   //hand the regions to the shard workers now; a failed send shows up as a failed query
+   if (options->shards != NULL && s->loaded && s->num_vertices <= MAXV)
+      send_shard_regions(&s->g, options->shards, s->scenario);
+
+   //read the start, destination and number of passengers
+   fscanf(fp_in, "%lld %lld %d", &s->start_id, &s->destination_id, &s->total_number_tourists);
+   s->start_city = find_vertex(&s->g, s->start_id);
+   s->destination_city = find_vertex(&s->g, s->destination_id);
+
+   return(true);
+}
+
+/* write the all-pairs bottleneck table of a scenario's graph */
+
+static void write_scenario_table(scenario_slot *s, scenario_options *options) {
+
+   bottleneck_table table;
+
+   if (!s->loaded || s->num_vertices > MAXV || s->g.ids.overflow) return;
+
+   table.scenario = s->scenario;
+   if (build_bottleneck_table(&s->g, &table)) {
+      //a failed write leaves a partial block; stop at the tables already written
+      if (!write_bottleneck_table(options->fp_table, &table)) {
+         printf("Error can't write bottleneck table for scenario %d\n", s->scenario);
+         fclose(options->fp_table);
+         options->fp_table = NULL;
+      }
+      free_bottleneck_table(&table);
+   }
+}
+
+/* Format a multi-route plan: every round each route carries its     */
+/* full load, except the last, which is filled route by route        */
+
+static void write_dispatch_plan(scenario_slot *s, dispatch_plan *plan) {
+
+   output_buffer *out = &s->out;
+   long long tourists = s->total_number_tourists;
+   long long rounds = (tourists + plan->max_flow - 1) / plan->max_flow;
+   long long last = tourists - (rounds - 1) * plan->max_flow;  /* carried in the final round */
+   long long i;
+   int used = plan->nroutes;     /* routes that carry anyone */
+   int k, j;
+
+   if (rounds == 1) {
+      for (used = 0, i = 0; i < last; used++) i += plan->load[used];
+   }
+
+   output_printf(out, "Minimum Number of Rounds = %lld: using %d routes\n", rounds, used);
+
+   for (k=0; k < used; k++) {
+      TRACE_ROUTE_EMIT(s->scenario, plan->route_start[k+1] - plan->route_start[k], plan->load[k]);
+      output_printf(out, "Route %d = %lld", k+1, s->start_id);
+      for (j = plan->route_start[k]; j < plan->route_start[k+1]; j++)
+         output_printf(out, "  %lld", get_vertex_id(&s->g, plan->vertices[j]));
+      output_printf(out, "\n");
+
+      output_printf(out, "Trips =");
+      for (i=0; i < rounds-1; i++)
+         output_printf(out, "  %d", plan->load[k]);
+      if (last > 0)
+         output_printf(out, "  %lld", (last < plan->load[k]) ? last : (long long) plan->load[k]);
+      last -= plan->load[k];
+      output_printf(out, "\n");
+   }
+}
+
+/* Solve a scenario that has been read, formatting the result in s->out */
+
+static void format_scenario(scenario_slot *s, scenario_options *options) {
+
+   output_buffer *out = &s->out;
+   int optimal_max_weight_array[MAXV];
+   int num_elements = 0;
+   int best_route_array[MAXV];
+   int best_route_counter = 0;
+   int start_city = s->start_city;
+   int destination_city = s->destination_city;
+   vertex_id start_id = s->start_id;
+   vertex_id destination_id = s->destination_id;
+   int total_number_tourists = s->total_number_tourists;
+   int i, j;
+
+   reset_output_buffer(out);
+   output_printf(out, "Scenario %d\n", s->scenario);
+
+   if (options->fp_table != NULL) write_scenario_table(s, options);
+
+   // check that the graph could be loaded: temporary files, then memory
+   if(s->temp_files_failed){
+      output_printf(out, "Temporary files for the external spanning tree could not be used... Not processing route\n");
+      output_printf(out, "\n");
+      return;
+   }
+   if(!s->loaded && get_memory_budget() == 0){
+      output_printf(out, "Out of memory... Not processing route\n");
+      output_printf(out, "\n");
+      return;
+   }
+   if(!s->loaded){
+      output_printf(out, "Memory budget of %lu bytes exceeded... Not processing route\n", (unsigned long) get_memory_budget());
+      output_printf(out, "\n");
+      return;
+   }
+
+   // check for same start vertex and destination vertex
+   if(start_id == destination_id){
+      output_printf(out, "Start Vertex %lld is the same as destination vertex %lld . Cannot be allowed\n", start_id, destination_id);
+      output_printf(out, "\n");
+      return;
+   }
+
+   //check for zero number of passengers
+   if(total_number_tourists <= 0){
+      output_printf(out, "Cannot transport %d number of passengers\n", total_number_tourists);
+      output_printf(out, "\n");
+      return;
+   }
+
+   //check for more than 20 numvertices
+   if(s->num_vertices > MAXV){
+      output_printf(out, "Number of vertices %d more than the limit of %d... Not processing route\n", s->num_vertices, MAXV);
+      output_printf(out, "\n");
+      return;
+   }
+
+   //check for more than 20 distinct cities in the edges
+   if(s->g.ids.overflow){
+      output_printf(out, "Number of distinct cities more than the limit of %d... Not processing route\n", MAXV);
+      output_printf(out, "\n");
+      return;
+   }
+
+   // reject unreachable destinations before building the tree
+   if(!same_component(&s->g, start_city, destination_city)){
+      output_printf(out, "No Path Found for start vertex %lld and destination vertex %lld\n", start_id, destination_id);
+      output_printf(out, "\n");
+      return;
+   }
+
+   // share the tourists over every route with spare capacity
+   if(options->dispatch){
+      dispatch_plan plan;
+
+      if(!max_flow_dispatch(&s->g, start_city, destination_city, &plan)){
+         output_printf(out, "Memory budget of %lu bytes exceeded... Not processing route\n", (unsigned long) get_memory_budget());
+      } else if(plan.max_flow <= 0 || plan.nroutes == 0){
+         output_printf(out, "No Path Found for start vertex %lld and destination vertex %lld\n", start_id, destination_id);
+      } else{
+         write_dispatch_plan(s, &plan);
+      }
+      free_dispatch_plan(&plan);
+      output_printf(out, "\n");
+      return;
+   }
+
+   // if there is path found
+   if(options->shards != NULL ?
+      find_path_sharded(&s->g, options->shards, s->scenario, start_city, destination_city, optimal_max_weight_array, &num_elements, best_route_array, &best_route_counter) :
+      find_path(&s->g, start_city, destination_city, optimal_max_weight_array, &num_elements, best_route_array, &best_route_counter)){
+
+      //get minimum weight in graph
+      int min_max_capacity = get_minimum_element(optimal_max_weight_array, num_elements);
+
+      //get minimum number of trips
+      int min_num_trips = total_number_tourists / (min_max_capacity -1);
+      int min_num_trips_remainder = total_number_tourists % (min_max_capacity -1);
+
+      if(min_num_trips_remainder > 0) min_num_trips += 1;
+
+      output_printf(out, "Minimum Number of Trips = %d: ", min_num_trips);
+
+      for (i=0; i < min_num_trips-1; i++){
+         output_printf(out, "  %d", min_max_capacity-1);
+      }
+
+      if(min_num_trips_remainder > 0) output_printf(out, "  %d", min_num_trips_remainder);
+      if(min_num_trips_remainder == 0) output_printf(out, "  %d", min_max_capacity-1);
+
+      //print best route
+      TRACE_ROUTE_EMIT(s->scenario, best_route_counter, min_max_capacity-1);
+      output_printf(out, "\n");
+      output_printf(out, "Route = %lld", start_id);
+      for(j=0; j < best_route_counter; j++){
+         output_printf(out, "  %lld", get_vertex_id(&s->g, best_route_array[j]));
+      }
+      output_printf(out, "\n");
+   } else{
+      output_printf(out, "No Path Found for start vertex %lld and destination vertex %lld\n", start_id, destination_id);
+   }
+
+   //nextline formatter
+   output_printf(out, "\n");
+}
+
+void solve_scenario(scenario_slot *s, scenario_options *options) {
+
+   TRACE_SCENARIO_START(s->scenario, s->num_vertices, s->num_edges);
+   format_scenario(s, options);
+   TRACE_SCENARIO_END(s->scenario, s->out.length);
+}
+
+void write_scenario(FILE *fp_out, scenario_slot *s) {
+
+   if (s->out.text != NULL)
+      fputs(s->out.text, fp_out);
+   if (s->out.truncated)
+      fprintf(fp_out, "Output for scenario %d truncated... out of memory\n\n", s->scenario);
+}
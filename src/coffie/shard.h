@@ -0,0 +1,64 @@
+/* 
+  Interface file
+
+  Sharded bottleneck routing - the vertices are partitioned into contiguous
+  regions and each region is handed to a worker process.  A worker builds
+  the maximum spanning forest of its region and summarizes it as the
+  bottleneck (and route) between every pair of its boundary vertices, that
+  is, vertices with an edge into another region plus the query endpoints.
+  The coordinator solves the query over the small boundary graph made of
+  these summaries and the cross-region edges, then expands the summary
+  edges back into a full route.
+
+  Workers are forked once and talk to the coordinator over local socket
+  pairs, so the whole arrangement runs on a single Linux machine.
+  Not available on Windows.
+
+  Each region is sent to its worker once, as soon as the scenario has been
+  read (send_shard_regions), and kept there under the scenario number;
+  a query then sends only the boundary vertices.  A worker holds
+  SHARD_REGIONS_HELD regions, by scenario number modulo that, so no more
+  than that many consecutively numbered scenarios may be read ahead of
+  the one being solved.  Regions may be sent from a reader thread while
+  another thread queries.
+
+*/
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <mutex>
+
+#include "graph.h"
+
+#define MAX_SHARDS 8             /* maximum number of worker processes */
+#define SHARD_REGIONS_HELD 8     /* regions each worker keeps          */
+
+typedef struct {
+   int nshards;                  /* number of workers / regions    */
+   int pid[MAX_SHARDS];          /* worker process ids             */
+   int fd[MAX_SHARDS];           /* coordinator end of each socket */
+   std::mutex sending;           /* one message at a time on fd[]  */
+} shard_pool;
+
+/* one summary edge: best route between two boundary vertices of a region */
+
+typedef struct {
+   int a, b;                     /* boundary vertices              */
+   int bottleneck;               /* smallest capacity on the route */
+   int length;                   /* vertices on route, after a     */
+   int route[MAXV];              /* a -> b, excluding a            */
+   int weight[MAXV];             /* width of the road into route[i] */
+} shard_summary;
+
+bool start_shard_workers(shard_pool *pool, int nshards);
+
+void stop_shard_workers(shard_pool *pool);
+
+int get_shard_region(int v, int nvertices, int nshards);
+
+bool send_shard_regions(graph *g, shard_pool *pool, int scenario);
+
+bool find_path_sharded(graph *g, shard_pool *pool, int scenario, int start, int end, int *optimal_max_weight_array, int *num_elements, int *best_route_array, int *best_route_counter);
+
+#endif
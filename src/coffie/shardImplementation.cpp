@@ -0,0 +1,508 @@
+/* 
+
+  Implementation file
+
+  Sharded bottleneck routing - see shard.h
+
+  Coordinator to worker messages (ints), each starting with a header
+  { command scenario count count }:
+
+     SHARD_LOAD      scenario num_vertices num_edges
+                     num_edges x { x y weight }
+     SHARD_SUMMARIZE scenario num_boundary 0
+                     num_boundary x { vertex }
+     SHARD_QUIT      0 0 0
+
+  Worker to coordinator reply, to SHARD_SUMMARIZE only (ints):
+
+     num_summaries, or -1 if the scenario's region is not held
+     num_summaries x { a b bottleneck length route[length] weight[length] }
+
+  Like prim(), routing ignores roads of weight 0 or less, and of parallel
+  roads only the widest is kept, so every hop has one known width: the
+  coordinator takes each hop's width from the summaries and from the
+  widest road across regions, never by searching an adjacency list.
+
+  Loads come from the thread reading scenarios and queries from the one
+  solving them, so pool->sending keeps each message whole.  A query sends
+  all its requests under the lock and then reads every reply without it,
+  so a worker is never left blocked on a reply while a load waits for it.
+
+*/
+
+#include "shard.h"
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define SHARD_QUIT      0
+#define SHARD_LOAD      1
+#define SHARD_SUMMARIZE 2
+
+#define SHARD_BATCH_EDGES 256    /* edges per write when loading */
+
+/* a region held by a worker */
+
+typedef struct {
+   int scenario;                 /* 0 when empty              */
+   bool complete;                /* every edge could be stored */
+   graph g;
+} shard_region;
+
+static bool write_ints(int fd, int *data, int n) {
+
+   size_t left = n * sizeof(int);
+   char *p = (char *) data;
+   ssize_t done;
+
+   while (left > 0) {
+      if ((done = write(fd, p, left)) <= 0) return(false);
+      p += done;
+      left -= done;
+   }
+   return(true);
+}
+
+static bool read_ints(int fd, int *data, int n) {
+
+   size_t left = n * sizeof(int);
+   char *p = (char *) data;
+   ssize_t done;
+
+   while (left > 0) {
+      if ((done = read(fd, p, left)) <= 0) return(false);
+      p += done;
+      left -= done;
+   }
+   return(true);
+}
+
+/* Worker: replace region r with the edges that follow, keeping only */
+/* the widest road between two cities and none of weight 0 or less    */
+
+static bool load_region(int fd, shard_region *r, int scenario, int num_vertices, int num_edges) {
+
+   static int widest[MAXV+1][MAXV+1];  /* 0: no usable road */
+   int edge[3];                  /* x, y, weight */
+   int i, x, y;
+   bool ok = true;
+
+   free_graph(&r->g);
+   initialize_graph(&r->g, false);
+   r->g.nvertices = num_vertices;
+   r->scenario = scenario;
+   r->complete = (num_vertices >= 0 && num_vertices <= MAXV);
+
+   for (x=0; x<=MAXV; x++)
+      for (y=0; y<=MAXV; y++) widest[x][y] = 0;
+
+   for (i=0; i<num_edges; i++) {
+      if (!read_ints(fd, edge, 3)) return(false);
+      x = edge[0];
+      y = edge[1];
+      if (x < 1 || x > MAXV || y < 1 || y > MAXV) continue;
+      if (edge[2] > widest[x][y]) widest[x][y] = widest[y][x] = edge[2];
+   }
+
+   for (x=1; x<=MAXV && ok; x++) {
+      for (y=x+1; y<=MAXV && ok; y++) {
+         if (widest[x][y] == 0) continue;
+         ok = insert_edge(&r->g, x, y, false, widest[x][y]);
+         uf_union(r->g.component, r->g.component_size, x, y);
+      }
+   }
+   if (!ok) r->complete = false;
+   return(true);
+}
+
+/* Worker: route between every pair of boundary vertices over the */
+/* region held for the scenario                                   */
+
+static bool summarize_region(int fd, shard_region *r, int scenario, int num_boundary) {
+
+   static shard_summary found[MAXV*(MAXV-1)/2];  /* summaries to send */
+   int boundary[MAXV];           /* boundary vertices    */
+   int num_weights;
+   shard_summary *summary;
+   int count = 0;
+   int i, j;
+
+   if (num_boundary < 0 || num_boundary > MAXV) return(false);
+   if (!read_ints(fd, boundary, num_boundary)) return(false);
+
+   if (r->scenario != scenario || !r->complete) {
+      count = -1;
+      return(write_ints(fd, &count, 1));
+   }
+
+   /* only pairs find_path() actually connects */
+
+   for (i=0; i<num_boundary; i++) {
+      for (j=i+1; j<num_boundary; j++) {
+         if (!same_component(&r->g, boundary[i], boundary[j])) continue;
+
+         summary = &found[count];
+         summary->a = boundary[i];
+         summary->b = boundary[j];
+         summary->length = 0;
+         num_weights = 0;
+         if (!find_path(&r->g, summary->a, summary->b, summary->weight, &num_weights, summary->route, &summary->length)
+             || summary->length == 0 || num_weights != summary->length) continue;
+         summary->bottleneck = get_minimum_element(summary->weight, num_weights);
+         count++;
+      }
+   }
+
+   if (!write_ints(fd, &count, 1)) return(false);
+
+   for (i=0; i<count; i++) {
+      if (!write_ints(fd, &found[i].a, 4)) return(false);
+      if (!write_ints(fd, found[i].route, found[i].length)) return(false);
+      if (!write_ints(fd, found[i].weight, found[i].length)) return(false);
+   }
+   return(true);
+}
+
+static void shard_worker(int fd) {
+
+   static shard_region held[SHARD_REGIONS_HELD];
+   int header[4];                /* command, scenario, two counts */
+   shard_region *r;
+   bool ok = true;
+   int k;
+
+   for (k=0; k<SHARD_REGIONS_HELD; k++) {
+      held[k].scenario = 0;
+      initialize_graph(&held[k].g, false);
+   }
+
+   while (ok && read_ints(fd, header, 4) && header[0] != SHARD_QUIT && header[1] > 0) {
+      r = &held[header[1] % SHARD_REGIONS_HELD];
+      if (header[0] == SHARD_LOAD)
+         ok = load_region(fd, r, header[1], header[2], header[3]);
+      else
+         ok = summarize_region(fd, r, header[1], header[2]);
+   }
+   close(fd);
+   _exit(0);                     /* don't flush the coordinator's stdio buffers */
+}
+
+/* Fork nshards workers; call before any files are written or threads started */
+
+bool start_shard_workers(shard_pool *pool, int nshards) {
+
+   int sv[2];                    /* socket pair */
+   int k, j;
+   int pid;
+
+   if (nshards < 1 || nshards > MAX_SHARDS) return(false);
+
+   fflush(NULL);
+   pool->nshards = 0;
+
+   for (k=0; k<nshards; k++) {
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) break;
+
+      if ((pid = fork()) == 0) {
+         close(sv[0]);
+         for (j=0; j<k; j++) close(pool->fd[j]);  /* siblings' sockets */
+         shard_worker(sv[1]);
+      }
+      close(sv[1]);
+      if (pid < 0) {
+         close(sv[0]);
+         break;
+      }
+      pool->pid[k] = pid;
+      pool->fd[k] = sv[0];
+      pool->nshards++;
+   }
+
+   if (pool->nshards < nshards) {
+      stop_shard_workers(pool);
+      return(false);
+   }
+   return(true);
+}
+
+void stop_shard_workers(shard_pool *pool) {
+
+   int header[4] = {SHARD_QUIT, 0, 0, 0};
+   int k;
+
+   std::lock_guard<std::mutex> lock(pool->sending);
+
+   for (k=0; k<pool->nshards; k++) {
+      write_ints(pool->fd[k], header, 4);
+      close(pool->fd[k]);
+      waitpid(pool->pid[k], NULL, 0);
+   }
+   pool->nshards = 0;
+}
+
+/* region of vertex v when vertices 1 .. nvertices are split in contiguous blocks */
+
+int get_shard_region(int v, int nvertices, int nshards) {
+   return(((v - 1) * nshards) / nvertices);
+}
+
+/* Send each worker the edges inside its region, to be kept under */
+/* the scenario number until a later scenario replaces them         */
+
+bool send_shard_regions(graph *g, shard_pool *pool, int scenario) {
+
+   int batch[3*SHARD_BATCH_EDGES];  /* x, y, weight triples */
+   int header[4];
+   int n = g->nvertices;
+   int k, v, m;
+   bool ok = true;
+   bool more;
+   edge_iterator e;
+
+   std::lock_guard<std::mutex> lock(pool->sending);
+
+   for (k=0; k<pool->nshards && ok; k++) {
+      header[0] = SHARD_LOAD;
+      header[1] = scenario;
+      header[2] = n;
+      header[3] = 0;
+      for (v=1; v<=n; v++) {
+         if (get_shard_region(v, n, pool->nshards) != k) continue;
+         for (more = first_edge(g, v, &e); more; more = next_edge(g, &e))
+            if (get_shard_region(e.y, n, pool->nshards) == k && v < e.y) header[3]++;
+      }
+      ok = write_ints(pool->fd[k], header, 4);
+
+      m = 0;
+      for (v=1; v<=n && ok; v++) {
+         if (get_shard_region(v, n, pool->nshards) != k) continue;
+         for (more = first_edge(g, v, &e); more && ok; more = next_edge(g, &e)) {
+            if (get_shard_region(e.y, n, pool->nshards) != k || v >= e.y) continue;
+            batch[m++] = v; batch[m++] = e.y; batch[m++] = e.weight;
+            if (m == 3*SHARD_BATCH_EDGES) {
+               ok = write_ints(pool->fd[k], batch, m);
+               m = 0;
+            }
+         }
+      }
+      if (ok && m > 0) ok = write_ints(pool->fd[k], batch, m);
+   }
+   return(ok);
+}
+
+/* append v, reached by a road of the given width, to the route, */
+/* cutting out any loop back to an earlier vertex                 */
+
+static void append_route_vertex(int start, int v, int width, int *optimal_max_weight_array, int *num_elements, int *best_route_array, int *best_route_counter) {
+
+   int i;
+
+   for (i=0; i<*best_route_counter; i++) {
+      if (best_route_array[i] == v) {
+         *best_route_counter = i + 1;
+         *num_elements = i + 1;
+         return;
+      }
+   }
+   if (v == start) {
+      *best_route_counter = 0;
+      *num_elements = 0;
+      return;
+   }
+
+   best_route_array[*best_route_counter] = v;
+   *best_route_counter += 1;
+   optimal_max_weight_array[*num_elements] = width;
+   *num_elements += 1;
+}
+
+/* Read one worker's whole reply into summaries[*count ..], stopping */
+/* only if the stream itself is broken. Summaries that do not fit    */
+/* are read and dropped. Return false if the reply was refused,      */
+/* broken or dropped anything; *broken is set if the stream is       */
+/* out of step and the worker can no longer be used.                 */
+
+static bool read_reply(int fd, shard_summary *summaries, int max_summaries, int *count, bool *broken) {
+
+   shard_summary scratch;
+   shard_summary *s;
+   int replies;
+   int i;
+   bool ok = true;
+
+   if (!read_ints(fd, &replies, 1)) {
+      *broken = true;
+      return(false);
+   }
+   if (replies < 0) return(false);
+
+   for (i=0; i<replies; i++) {
+      s = (*count < max_summaries) ? &summaries[*count] : &scratch;
+      if (!read_ints(fd, &s->a, 4) || s->length < 0 || s->length > MAXV
+          || !read_ints(fd, s->route, s->length) || !read_ints(fd, s->weight, s->length)) {
+         *broken = true;
+         return(false);
+      }
+      if (s == &scratch || s->a < 1 || s->a > MAXV || s->b < 1 || s->b > MAXV) ok = false;
+      else (*count)++;
+   }
+   return(ok);
+}
+
+/* Same contract as find_path(), with the work split across the worker */
+/* pool; the scenario's regions must have been sent already            */
+
+bool find_path_sharded(graph *g, shard_pool *pool, int scenario, int start, int end, int *optimal_max_weight_array, int *num_elements, int *best_route_array, int *best_route_counter) {
+
+   graph boundary_graph;         /* cross-region edges plus summaries */
+   shard_summary *summaries;     /* summaries from every worker       */
+   shard_summary *s;
+   int max_summaries;
+   int count = 0;                /* summaries received                */
+   int cross[MAXV+1][MAXV+1];    /* widest road across regions, 0: none */
+   int summary_of[MAXV+1][MAXV+1];  /* summary between two cities, -1: none */
+   bool is_boundary[MAXV+1];
+   bool sent[MAX_SHARDS];        /* worker owes a reply               */
+   bool broken = false;          /* a reply stream fell out of step   */
+   int header[4];
+   int route[MAXV];              /* route over the boundary graph     */
+   int route_length = 0;
+   int weights[MAXV];
+   int num_weights = 0;
+   int region_of[MAXV+1];
+   int n = g->nvertices;
+   int k, i, j, v, w, previous;
+   bool ok = true;
+   bool more;
+   edge_iterator e;
+
+   if ((start < 1) || (start > n) || (end < 1) || (end > n) || n > MAXV) return(false);
+
+   max_summaries = (n * n) / 2 + 1;
+   summaries = (shard_summary *) memory_allocate(MEM_CACHE, max_summaries * sizeof(shard_summary));
+   if (summaries == NULL) return(false);
+
+   /* boundary vertices: a usable road leaving the region, or a query endpoint */
+
+   for (v=1; v<=n; v++) {
+      region_of[v] = get_shard_region(v, n, pool->nshards);
+      is_boundary[v] = (v == start) || (v == end);
+      for (w=1; w<=n; w++) {
+         cross[v][w] = 0;
+         summary_of[v][w] = -1;
+      }
+   }
+   for (v=1; v<=n; v++) {
+      for (more = first_edge(g, v, &e); more; more = next_edge(g, &e)) {
+         if (region_of[e.y] == region_of[v] || e.weight <= 0) continue;
+         is_boundary[v] = true;
+         if (e.weight > cross[v][e.y]) cross[v][e.y] = cross[e.y][v] = e.weight;
+      }
+   }
+
+   /* ask each worker to summarize its region between its boundary vertices */
+
+   pool->sending.lock();
+   for (k=0; k<pool->nshards; k++) {
+      header[0] = SHARD_SUMMARIZE;
+      header[1] = scenario;
+      header[2] = 0;
+      header[3] = 0;
+      for (v=1; v<=n; v++)
+         if (region_of[v] == k && is_boundary[v]) header[2]++;
+      sent[k] = write_ints(pool->fd[k], header, 4);
+
+      for (v=1; v<=n && sent[k]; v++)
+         if (region_of[v] == k && is_boundary[v]) sent[k] = write_ints(pool->fd[k], &v, 1);
+      if (!sent[k]) ok = false;
+   }
+   pool->sending.unlock();
+
+   /* every reply is read in full, even after a failure, so that the */
+   /* next query finds the streams in step                           */
+
+   for (k=0; k<pool->nshards; k++)
+      if (sent[k] && !read_reply(pool->fd[k], summaries, max_summaries, &count, &broken)) ok = false;
+   if (broken) printf("Error shard worker reply out of step\n");
+
+   for (i=0; i<count; i++)
+      summary_of[summaries[i].a][summaries[i].b] = summary_of[summaries[i].b][summaries[i].a] = i;
+
+   /* one edge per pair in the boundary graph: the wider of the road */
+   /* across regions and the summary within one                      */
+
+   initialize_graph(&boundary_graph, false);
+   boundary_graph.nvertices = n;
+
+   for (v=1; v<=n && ok; v++) {
+      for (w=v+1; w<=n && ok; w++) {
+         i = cross[v][w];
+         if (summary_of[v][w] >= 0 && summaries[summary_of[v][w]].bottleneck > i)
+            i = summaries[summary_of[v][w]].bottleneck;
+         if (i <= 0) continue;
+         ok = insert_edge(&boundary_graph, v, w, false, i);
+         uf_union(boundary_graph.component, boundary_graph.component_size, v, w);
+      }
+   }
+
+   /* route over the boundary graph, then expand each summary edge */
+
+   if (ok && same_component(&boundary_graph, start, end) &&
+       find_path(&boundary_graph, start, end, weights, &num_weights, route, &route_length)) {
+
+      previous = start;
+      for (i=0; i<route_length; i++) {
+         v = route[i];
+         s = (summary_of[previous][v] >= 0) ? &summaries[summary_of[previous][v]] : NULL;
+         if (s != NULL && s->bottleneck >= cross[previous][v]) {
+            if (s->a == previous) {
+               for (j=0; j<s->length; j++)
+                  append_route_vertex(start, s->route[j], s->weight[j], optimal_max_weight_array, num_elements, best_route_array, best_route_counter);
+            }
+            else {                /* walk the summary route backwards */
+               for (j=s->length-2; j>=0; j--)
+                  append_route_vertex(start, s->route[j], s->weight[j+1], optimal_max_weight_array, num_elements, best_route_array, best_route_counter);
+               append_route_vertex(start, s->a, s->weight[0], optimal_max_weight_array, num_elements, best_route_array, best_route_counter);
+            }
+         }
+         else {
+            append_route_vertex(start, v, cross[previous][v], optimal_max_weight_array, num_elements, best_route_array, best_route_counter);
+         }
+         previous = v;
+      }
+   }
+   else {
+      ok = false;
+   }
+
+   free_graph(&boundary_graph);
+   memory_free(MEM_CACHE, summaries);
+   return(ok && *best_route_counter > 0);
+}
+
+#else
+
+bool start_shard_workers(shard_pool *pool, int nshards) {
+   pool->nshards = 0;
+   return(false);
+}
+
+void stop_shard_workers(shard_pool *pool) {
+}
+
+int get_shard_region(int v, int nvertices, int nshards) {
+   return(((v - 1) * nshards) / nvertices);
+}
+
+bool send_shard_regions(graph *g, shard_pool *pool, int scenario) {
+   return(false);
+}
+
+bool find_path_sharded(graph *g, shard_pool *pool, int scenario, int start, int end, int *optimal_max_weight_array, int *num_elements, int *best_route_array, int *best_route_counter) {
+   return(find_path(g, start, end, optimal_max_weight_array, num_elements, best_route_array, best_route_counter));
+}
+
+#endif
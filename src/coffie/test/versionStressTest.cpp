@@ -0,0 +1,152 @@
+/* 
+
+  Test program
+
+  Versioned graph snapshots - reader/writer stress test, see version.h
+
+  One writer repeatedly builds a version in which every road has the same
+  capacity, the version's stamp, sometimes adding a road first; a third
+  of the updates are aborted instead of published.  Reader threads, more
+  than MAX_GRAPH_READERS of them, acquire the current version and check
+  that it is consistent: every road has the same capacity, the component
+  labels agree with the roads, and find_path() returns that capacity as
+  the bottleneck.  At the end every tracked graph byte must be back.
+
+  Exit status 0 on success, 1 on any inconsistency.
+
+*/
+
+#include <thread>
+#include <vector>
+
+#include "../version.h"
+
+#define READERS     (MAX_GRAPH_READERS + 16)
+#define UPDATES     20000
+#define VERTICES    MAXV
+
+extern bool debug;
+
+static std::atomic<bool> stop(false);
+static std::atomic<long> reads(0);
+static std::atomic<long> failures(0);
+
+/* check one snapshot; return false if it is inconsistent */
+
+static bool check_snapshot(graph *g) {
+
+   int weights[MAXV];
+   int route[MAXV];
+   int num_weights = 0;
+   int route_length = 0;
+   int stamp = -1;
+   int v;
+   edgenode *p;
+
+   for (v=1; v<=g->nvertices; v++) {
+      for (p = g->edges[v]; p != NULL; p = p->next) {
+         if (stamp == -1) stamp = p->weight;
+         if (p->weight != stamp) return(false);
+         if (!same_component(g, v, p->y)) return(false);
+      }
+   }
+   if (stamp == -1) return(false);
+
+   if (!same_component(g, 1, 2)) return(false);
+   if (!find_path(g, 1, 2, weights, &num_weights, route, &route_length)) return(false);
+   if (get_minimum_element(weights, num_weights) != stamp) return(false);
+
+   if (same_component(g, 1, VERTICES)) {
+      num_weights = route_length = 0;
+      if (!find_path(g, 1, VERTICES, weights, &num_weights, route, &route_length)) return(false);
+      if (get_minimum_element(weights, num_weights) != stamp) return(false);
+   }
+   return(true);
+}
+
+static void reader(versioned_graph *vg) {
+
+   graph *g;
+   int slot;
+
+   while (!stop) {
+      if ((g = acquire_graph(vg, &slot)) == NULL) {  /* every slot busy */
+         std::this_thread::yield();
+         continue;
+      }
+      if (!check_snapshot(g)) failures++;
+      release_graph(vg, slot);
+      reads++;
+   }
+}
+
+int main() {
+
+   graph g;
+   versioned_graph vg;
+   graph_version *v;
+   std::vector<std::thread> readers;
+   int road_x[MAXV], road_y[MAXV];   /* roads of the current version */
+   int nroads = 0;
+   int i, k, stamp;
+   bool ok;
+
+   debug = false;
+
+   /* a path over the first half of the vertices, capacity 1 */
+
+   initialize_graph(&g, false);
+   g.nvertices = VERTICES;
+   for (i=1; i<VERTICES/2; i++) {
+      insert_edge(&g, i, i+1, false, 1);
+      uf_union(g.component, g.component_size, i, i+1);
+      road_x[nroads] = i;
+      road_y[nroads++] = i+1;
+   }
+   if (!init_versioned_graph(&vg, &g)) {
+      printf("init_versioned_graph failed\n");
+      return(1);
+   }
+
+   for (k=0; k<READERS; k++)
+      readers.push_back(std::thread(reader, &vg));
+
+   for (i=0; i<UPDATES; i++) {
+      stamp = 2 + i % 1000;
+      if ((v = begin_graph_update(&vg)) == NULL) {
+         failures++;
+         break;
+      }
+
+      ok = true;
+      if (i % 500 == 0 && nroads < VERTICES-1)  /* extend the path by one road */
+         ok = versioned_insert_edge(v, road_y[nroads-1], road_y[nroads-1]+1, false, stamp);
+      for (k=0; k<nroads && ok; k++)
+         ok = versioned_update_capacity(v, road_x[k], road_y[k], false, stamp);
+
+      if (!ok) failures++;
+      if (!ok || i % 3 == 0) {
+         abort_graph_update(&vg, v);
+      }
+      else {
+         if (i % 500 == 0 && nroads < VERTICES-1) {
+            road_x[nroads] = road_y[nroads-1];
+            road_y[nroads] = road_y[nroads-1]+1;
+            nroads++;
+         }
+         publish_graph_update(&vg, v);
+      }
+   }
+
+   stop = true;
+   for (k=0; k<READERS; k++)
+      readers[k].join();
+
+   reclaim_graph_versions(&vg);
+   free_versioned_graph(&vg);
+
+   printf("%ld reads, %d roads, %ld failures, %lu graph bytes left\n",
+          reads.load(), nroads, failures.load(), (unsigned long) get_current_memory(MEM_GRAPH));
+
+   return((failures == 0 && get_current_memory(MEM_GRAPH) == 0) ? 0 : 1);
+}
@@ -0,0 +1,78 @@
+/* 
+  Interface file
+
+  Versioned graph snapshots - copy-on-write versions of a graph, published
+  atomically, so that route queries never block on capacity updates.
+
+  A writer starts a new version as a copy of the current graph structure;
+  the edgenode lists themselves are shared.  Inserting an edge only pushes a
+  new edgenode on the head of a list, so the old lists are untouched.
+  Changing a capacity copies the list prefix up to the changed edgenode and
+  leaves the rest shared.  Publishing swaps the current version pointer.
+
+  Readers claim a free announcement slot of the graph, announce the global
+  epoch in it, use whatever version was current, and clear the slot when
+  done; they never lock.  A replaced version,
+  along with the edgenodes only it could reach, is freed once no reader
+  announced an epoch at or before the one in which it was replaced.
+
+  Component labels are flattened before a version is published, so the
+  union-find lookups readers make never write to it.  Packed (compressed)
+  and grid graphs cannot be versioned.
+
+  An update that fails part way (out of memory, or no such edge) can be
+  dropped with abort_graph_update(), which frees the edgenodes it made.
+
+*/
+
+#ifndef VERSION_H
+#define VERSION_H
+
+#include <atomic>
+#include <mutex>
+
+#include "graph.h"
+
+#define MAX_GRAPH_READERS 64     /* reads that may be in progress at once */
+
+typedef struct graph_version {
+   graph g;                      /* adjacency lists shared with other versions */
+   edgenode **superseded;        /* edgenodes its successor no longer uses;    */
+   int nsuperseded;              /* freed together with this version           */
+   int superseded_size;
+   edgenode **made;              /* edgenodes allocated by this update,        */
+   int nmade;                    /* freed if it is aborted                     */
+   int made_size;
+   unsigned long retire_epoch;   /* epoch in which it stopped being current    */
+   struct graph_version *next_retired;
+} graph_version;
+
+typedef struct {
+   std::atomic<graph_version *> current;              /* published version */
+   std::atomic<unsigned long> epoch;                  /* global epoch      */
+   std::atomic<unsigned long> reader_epoch[MAX_GRAPH_READERS]; /* 0 = free */
+   graph_version *retired;       /* replaced versions awaiting reclamation */
+   std::mutex writer;            /* serializes writers only                */
+} versioned_graph;
+
+bool init_versioned_graph(versioned_graph *vg, graph *g);
+
+void free_versioned_graph(versioned_graph *vg);
+
+graph *acquire_graph(versioned_graph *vg, int *reader);
+
+void release_graph(versioned_graph *vg, int reader);
+
+graph_version *begin_graph_update(versioned_graph *vg);
+
+bool versioned_insert_edge(graph_version *v, int x, int y, bool directed, int w);
+
+bool versioned_update_capacity(graph_version *v, int x, int y, bool directed, int w);
+
+void publish_graph_update(versioned_graph *vg, graph_version *v);
+
+void abort_graph_update(versioned_graph *vg, graph_version *v);
+
+int reclaim_graph_versions(versioned_graph *vg);
+
+#endif
@@ -0,0 +1,333 @@
+/* 
+
+  Implementation file
+
+  Versioned graph snapshots - see version.h
+
+  While a new version is being built, its superseded[] array collects the
+  edgenodes that the version replaced.  On publishing, the array is handed
+  to the previous version, because those edgenodes are now reachable only
+  from it (and from older versions, which are always reclaimed first).
+  Its made[] array lists the edgenodes it allocated, which only it can
+  reach until it is published.
+
+*/
+
+#include "version.h"
+
+static graph_version *new_graph_version() {
+
+   graph_version *v;
+
+   v = (graph_version *) memory_allocate(MEM_GRAPH, sizeof(graph_version));
+   if (v == NULL) return(NULL);
+
+   v->superseded = NULL;
+   v->nsuperseded = 0;
+   v->superseded_size = 0;
+   v->made = NULL;
+   v->nmade = 0;
+   v->made_size = 0;
+   v->retire_epoch = 0;
+   v->next_retired = NULL;
+   return(v);
+}
+
+/* free a version and the edgenodes only it could reach */
+
+static void free_graph_version(graph_version *v) {
+
+   int i;
+
+   for (i=0; i<v->nsuperseded; i++)
+      memory_free(MEM_GRAPH, v->superseded[i]);
+   memory_free(MEM_GRAPH, v->superseded);
+   memory_free(MEM_GRAPH, v->made);
+   memory_free(MEM_GRAPH, v);
+}
+
+/* make room for n more edgenodes in an array of count of size */
+
+static bool reserve_edgenodes(edgenode ***array, int count, int *size, int n) {
+
+   edgenode **bigger;
+   int new_size;
+
+   if (count + n <= *size) return(true);
+
+   new_size = (*size == 0) ? 16 : *size;
+   while (new_size < count + n) new_size *= 2;
+
+   bigger = (edgenode **) memory_allocate(MEM_GRAPH, new_size * sizeof(edgenode *));
+   if (bigger == NULL) return(false);
+
+   if (count > 0) memcpy(bigger, *array, count * sizeof(edgenode *));
+   memory_free(MEM_GRAPH, *array);
+   *array = bigger;
+   *size = new_size;
+   return(true);
+}
+
+/* Point every vertex straight at its component's root, so that     */
+/* uf_find() on a published version never compresses a path: readers */
+/* share the component[] array and must only read it                 */
+
+static void flatten_components(graph *g) {
+
+   int i;
+
+   for (i=1; i<=MAXV; i++)
+      g->component[i] = uf_find(g->component, i);
+
+   g->ncomponents = 0;
+   for (i=1; i<=g->nvertices; i++)
+      if (g->component[i] == i) g->ncomponents++;
+}
+
+/* Take over the edgenode lists of g, which is left empty, as version */
+/* 1. Packed and grid graphs are refused: their edges are not read    */
+/* from the lists that versions share and update.                     */
+
+bool init_versioned_graph(versioned_graph *vg, graph *g) {
+
+   graph_version *v;
+   int i;
+
+   if (g->packed.bytes != NULL || g->grid.cells != NULL) return(false);
+
+   if ((v = new_graph_version()) == NULL) return(false);
+
+   v->g = *g;
+   for (i=1; i<=MAXV; i++) g->edges[i] = NULL;
+   flatten_components(&v->g);
+
+   vg->current.store(v);
+   vg->epoch.store(1);
+   for (i=0; i<MAX_GRAPH_READERS; i++) vg->reader_epoch[i].store(0);
+   vg->retired = NULL;
+   return(true);
+}
+
+/* free every version; no reader may be active */
+
+void free_versioned_graph(versioned_graph *vg) {
+
+   graph_version *v;
+
+   while ((v = vg->retired) != NULL) {
+      vg->retired = v->next_retired;
+      free_graph_version(v);
+   }
+
+   v = vg->current.load();
+   free_graph(&v->g);
+   free_graph_version(v);
+   vg->current.store(NULL);
+}
+
+/* Readers: pin the current version until release_graph(), which   */
+/* is passed the *reader slot set here.  Return NULL if all           */
+/* MAX_GRAPH_READERS slots of this graph are in use.                  */
+
+graph *acquire_graph(versioned_graph *vg, int *reader) {
+
+   unsigned long idle;           /* expected slot value */
+   int i;
+
+   /* announce first, then load: a writer that misses the announcement */
+   /* has already published, so the load sees the new version          */
+
+   for (i=0; i<MAX_GRAPH_READERS; i++) {
+      idle = 0;
+      if (vg->reader_epoch[i].compare_exchange_strong(idle, vg->epoch.load())) {
+         *reader = i;
+         return(&vg->current.load()->g);
+      }
+   }
+   *reader = -1;
+   return(NULL);
+}
+
+void release_graph(versioned_graph *vg, int reader) {
+
+   if (reader >= 0) vg->reader_epoch[reader].store(0);
+}
+
+/* Writers: start a new version sharing every list with the current one; */
+/* the writer lock is held until publish_graph_update()                  */
+
+graph_version *begin_graph_update(versioned_graph *vg) {
+
+   graph_version *v;
+
+   vg->writer.lock();
+
+   if ((v = new_graph_version()) == NULL) {
+      vg->writer.unlock();
+      return(NULL);
+   }
+   v->g = vg->current.load()->g;
+   return(v);
+}
+
+/* new edgenodes go on the list heads, so shared nodes are never touched */
+
+bool versioned_insert_edge(graph_version *v, int x, int y, bool directed, int w) {
+
+   edgenode *old_x, *old_y;      /* list heads before the insert */
+   edgenode *p;
+   bool ok;
+
+   if ((x < 1) || (x > v->g.nvertices) || (y < 1) || (y > v->g.nvertices)) return(false);
+
+   if (!reserve_edgenodes(&v->made, v->nmade, &v->made_size, 2)) return(false);
+
+   old_x = v->g.edges[x];
+   old_y = v->g.edges[y];
+   ok = insert_edge(&v->g, x, y, directed, w);
+
+   /* record whatever was pushed, even by a half-done undirected insert */
+
+   for (p = v->g.edges[x]; p != old_x; p = p->next) v->made[v->nmade++] = p;
+   if (y != x)
+      for (p = v->g.edges[y]; p != old_y; p = p->next) v->made[v->nmade++] = p;
+   if (!ok) return(false);
+
+   uf_union(v->g.component, v->g.component_size, x, y);
+   return(true);
+}
+
+/* copy x's list up to its first edge to y, with the new weight */
+
+static bool copy_prefix(graph_version *v, int x, int y, int w) {
+
+   edgenode *p, *q;              /* original list         */
+   edgenode *first = NULL;       /* copied prefix         */
+   edgenode *last = NULL;
+   edgenode *copy;
+   int length = 0;
+   int copied = 0;
+
+   for (p = v->g.edges[x]; p != NULL && p->y != y; p = p->next) length++;
+   if (p == NULL) return(false);  /* no such edge */
+
+   if (!reserve_edgenodes(&v->superseded, v->nsuperseded, &v->superseded_size, length + 1)) return(false);
+   if (!reserve_edgenodes(&v->made, v->nmade, &v->made_size, length + 1)) return(false);
+
+   for (q = v->g.edges[x]; ; q = q->next) {
+      copy = (EDGENODE_PTR) memory_allocate(MEM_GRAPH, sizeof(edgenode));
+      if (copy == NULL) {
+         while (copied-- > 0) {
+            copy = first->next;
+            memory_free(MEM_GRAPH, first);
+            first = copy;
+         }
+         return(false);
+      }
+      *copy = *q;
+      copied++;
+      if (first == NULL) first = copy;
+      else last->next = copy;
+      last = copy;
+      if (q == p) break;
+   }
+   last->weight = w;
+   last->next = p->next;         /* the suffix stays shared */
+
+   for (q = v->g.edges[x]; q != p->next; q = q->next)
+      v->superseded[v->nsuperseded++] = q;
+   for (q = first; q != p->next; q = q->next)
+      v->made[v->nmade++] = q;
+
+   v->g.edges[x] = first;
+   return(true);
+}
+
+/* On failure the update may be half done; abort it */
+
+bool versioned_update_capacity(graph_version *v, int x, int y, bool directed, int w) {
+
+   if ((x < 1) || (x > v->g.nvertices) || (y < 1) || (y > v->g.nvertices)) return(false);
+
+   if (!copy_prefix(v, x, y, w)) return(false);
+   if (w > v->g.max_weight) v->g.max_weight = w;
+   if (directed == false)
+      return(copy_prefix(v, y, x, w));
+   return(true);
+}
+
+/* Make v current; the previous version is retired, then reclaimed */
+/* when no reader can still be using it                            */
+
+void publish_graph_update(versioned_graph *vg, graph_version *v) {
+
+   graph_version *old;
+
+   flatten_components(&v->g);
+   old = vg->current.exchange(v);
+
+   old->superseded = v->superseded;
+   old->nsuperseded = v->nsuperseded;
+   old->superseded_size = v->superseded_size;
+   v->superseded = NULL;
+   v->nsuperseded = 0;
+   v->superseded_size = 0;
+
+   memory_free(MEM_GRAPH, v->made);   /* its edgenodes now belong to the graph */
+   v->made = NULL;
+   v->nmade = 0;
+   v->made_size = 0;
+
+   old->retire_epoch = vg->epoch++;
+   old->next_retired = vg->retired;
+   vg->retired = old;
+
+   reclaim_graph_versions(vg);
+   vg->writer.unlock();
+}
+
+/* Drop an unpublished version and every edgenode it allocated; the */
+/* edgenodes it superseded still belong to the current version      */
+
+void abort_graph_update(versioned_graph *vg, graph_version *v) {
+
+   int i;
+
+   for (i=0; i<v->nmade; i++)
+      memory_free(MEM_GRAPH, v->made[i]);
+   v->nmade = 0;
+   v->nsuperseded = 0;
+
+   free_graph_version(v);
+   vg->writer.unlock();
+}
+
+/* free retired versions no reader can see; return how many were freed */
+
+int reclaim_graph_versions(versioned_graph *vg) {
+
+   graph_version **link;
+   graph_version *v;
+   unsigned long oldest = 0;     /* oldest announced epoch, 0 if none */
+   unsigned long e;
+   int i;
+   int freed = 0;
+
+   for (i=0; i<MAX_GRAPH_READERS; i++) {
+      e = vg->reader_epoch[i].load();
+      if (e != 0 && (oldest == 0 || e < oldest)) oldest = e;
+   }
+
+   link = &vg->retired;
+   while ((v = *link) != NULL) {
+      if (oldest == 0 || v->retire_epoch < oldest) {
+         *link = v->next_retired;
+         free_graph_version(v);
+         freed++;
+      }
+      else {
+         link = &v->next_retired;
+      }
+   }
+   return(freed);
+}